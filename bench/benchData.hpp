@@ -0,0 +1,56 @@
+#pragma once
+
+#include "config.hpp"
+#include "dbInterface.hpp"
+#include "dbService.hpp"
+#include "inventoryGenerator.hpp"
+#include "logger.hpp"
+#include "threadPool.hpp"
+
+#include <format>
+#include <memory>
+
+namespace Bench {
+// The core services wired up like main.cpp does, minus the database: the snapshot is injected instead of loaded.
+struct Fixture {
+    Logger logger;
+    Config config{logger};
+    ThreadPool pool{4, 2, logger};
+    DbInterface dbInterface{logger};
+    DbService dbService{dbInterface, pool, config, logger};
+    std::shared_ptr<const CompleteDbData> data;
+
+    static GeneratorOptions withParts(std::size_t parts) {
+        GeneratorOptions options;
+        options.parts = parts;
+        options.depth = 2;
+        return options;
+    }
+
+    explicit Fixture(GeneratorOptions options) : data(std::make_shared<const CompleteDbData>(InventoryGenerator{options}.getData())) {
+        logger.setMinLevel(LogLevel::ERR); // keep the benchmark output readable
+        Change::setLogger(logger);
+        dbService.injectData(data);
+        dbService.getCompleteData(); // picks the injected snapshot up, like the ui thread would
+    }
+
+    std::size_t totalRows() const {
+        std::size_t rows = 0;
+        for (const auto& [table, count] : data->maxPKeys) {
+            rows += count;
+        }
+        return rows;
+    }
+};
+
+// an insert into parts whose references do not exist yet, so adding it also generates the required changes below it
+inline Change::colValMap newPart(const CompleteDbData& data, std::size_t index) {
+    Change::colValMap cells{
+        {"name", std::format("NEW{:07}", index)}, {"description", "bench"}, {InventoryGenerator::QUANTITY_COLUMN, "10"}};
+    for (const HeaderInfo& header : data.headers.at(InventoryGenerator::PARTS_TABLE).data) {
+        if (header.type != DB::HeaderTypes::FOREIGN_KEY) { continue; }
+        cells.emplace(header.name, std::format("{}-new-{}", header.referencedTable, index));
+    }
+    return cells;
+}
+} // namespace Bench
@@ -0,0 +1,87 @@
+#include "autoInv.hpp"
+#include "csvReader.hpp"
+#include "csvScanner.hpp"
+#include "inventoryGenerator.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace {
+constexpr std::size_t BUFFER_BYTES = 256 * 1024 * 1024;
+
+// a generated bom repeated up to BUFFER_BYTES, in memory so the disk stays out of the measurement
+const std::string& largeCsv() {
+    static const std::string csv = [] {
+        Logger logger;
+        logger.setMinLevel(LogLevel::ERR);
+        GeneratorOptions options;
+        options.bomRows = 100000;
+        options.orderRows = 0;
+        const std::filesystem::path path = std::filesystem::temp_directory_path() / "inventoryBenchScan.csv";
+        writeData(path, InventoryGenerator{options}.getBom(), logger);
+        std::stringstream file;
+        file << std::ifstream{path, std::ios::binary}.rdbuf();
+        std::filesystem::remove(path);
+
+        const std::string generated = file.str();
+        const std::string_view body = std::string_view{generated}.substr(generated.find('\n') + 1);
+        std::string out = generated;
+        out.reserve(BUFFER_BYTES + generated.size());
+        while (out.size() < BUFFER_BYTES) {
+            out += body;
+        }
+        return out;
+    }();
+    return csv;
+}
+
+void setScanLabel(benchmark::State& state) {
+    state.SetLabel(static_cast<CsvScanMode>(state.range(0)) == CsvScanMode::SCALAR ? "scalar" : "auto");
+}
+} // namespace
+
+// classification only, the part that is vectorized
+static void BM_CsvClassify(benchmark::State& state) {
+    const std::string& csv = largeCsv();
+    const auto classify = static_cast<CsvScanMode>(state.range(0)) == CsvScanMode::SCALAR ? &CsvScan::classifyScalar : &CsvScan::classify;
+    const std::size_t blocks = csv.size() / CSV_BLOCK_SIZE;
+
+    for (auto _ : state) {
+        uint64_t carry = 0;
+        uint64_t structurals = 0;
+        for (std::size_t i = 0; i < blocks; ++i) {
+            const CsvBlockMasks masks = classify(csv.data() + i * CSV_BLOCK_SIZE);
+            structurals ^= (masks.separators | masks.recordEnds) & ~CsvScan::insideQuotes(masks.quotes, carry);
+        }
+        benchmark::DoNotOptimize(structurals);
+    }
+    setScanLabel(state);
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(blocks * CSV_BLOCK_SIZE));
+}
+BENCHMARK(BM_CsvClassify)->Arg(static_cast<int64_t>(CsvScanMode::AUTO))->Arg(static_cast<int64_t>(CsvScanMode::SCALAR));
+
+// classification plus field extraction, what readData pays per file
+static void BM_CsvParse(benchmark::State& state) {
+    const std::string& csv = largeCsv();
+    Logger logger;
+    logger.setMinLevel(LogLevel::ERR);
+
+    for (auto _ : state) {
+        CsvReader reader{logger};
+        reader.setScanMode(static_cast<CsvScanMode>(state.range(0)));
+        reader.openBuffer(csv);
+        CsvChunk chunk;
+        while (reader.nextChunk(chunk, 4096)) {
+            benchmark::DoNotOptimize(chunk.fields.data());
+        }
+    }
+    setScanLabel(state);
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(csv.size()));
+}
+BENCHMARK(BM_CsvParse)
+    ->Arg(static_cast<int64_t>(CsvScanMode::AUTO))
+    ->Arg(static_cast<int64_t>(CsvScanMode::SCALAR))
+    ->Unit(benchmark::kMillisecond);
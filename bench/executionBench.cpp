@@ -0,0 +1,106 @@
+#include "benchData.hpp"
+#include "changeTracker.hpp"
+
+#include <benchmark/benchmark.h>
+
+// Applying needs a database, so this covers what happens around it: snapshotting the tracker for the ui and turning the
+// changes into sql.
+
+namespace {
+void fillTracker(Bench::Fixture& fixture, ChangeTracker& tracker, int64_t count) {
+    tracker.setMaxPKeys(fixture.data->maxPKeys);
+    const ImTable table = fixture.dbService.getTable(InventoryGenerator::PARTS_TABLE);
+    for (int64_t i = 0; i < count; ++i) {
+        tracker.addChange(Change{Bench::newPart(*fixture.data, static_cast<std::size_t>(i)), ChangeType::INSERT_ROW, table});
+    }
+}
+} // namespace
+
+// what the ui pays per frame while nothing changes
+static void BM_TrackerSnapshot(benchmark::State& state) {
+    Bench::Fixture fixture{Bench::Fixture::withParts(10000)};
+    ChangeTracker tracker{fixture.dbService, fixture.logger};
+    fillTracker(fixture, tracker, state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tracker.getSnapShot());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TrackerSnapshot)->Arg(100)->Arg(1000)->Arg(10000);
+
+// one selection toggled per frame, the touched table is copied again
+static void BM_TrackerSnapshotAfterEdit(benchmark::State& state) {
+    Bench::Fixture fixture{Bench::Fixture::withParts(10000)};
+    ChangeTracker tracker{fixture.dbService, fixture.logger};
+    fillTracker(fixture, tracker, state.range(0));
+    const std::size_t root = *tracker.getRoots().begin();
+    for (auto _ : state) {
+        tracker.toggleChangeSelect(root);
+        benchmark::DoNotOptimize(tracker.getSnapShot());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TrackerSnapshotAfterEdit)->Arg(100)->Arg(1000)->Arg(10000);
+
+static void BM_GenerateSql(benchmark::State& state) {
+    Bench::Fixture fixture{Bench::Fixture::withParts(10000)};
+    ChangeTracker tracker{fixture.dbService, fixture.logger};
+    fillTracker(fixture, tracker, state.range(0));
+    const std::shared_ptr<const uiChangeInfo> snapshot = tracker.getSnapShot();
+    for (auto _ : state) {
+        for (const auto& [table, tableChanges] : snapshot->tables) {
+            for (const auto& [key, change] : tableChanges->changes) {
+                benchmark::DoNotOptimize(change.toSQLaction(SqlAction::EXECUTE));
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(snapshot->changeCount()));
+}
+BENCHMARK(BM_GenerateSql)->Arg(100)->Arg(1000);
+
+// what execution copies out of the tracker before applying everything, one read lock for the whole walk
+static void BM_CollectSubtrees(benchmark::State& state) {
+    Bench::Fixture fixture{Bench::Fixture::withParts(10000)};
+    ChangeTracker tracker{fixture.dbService, fixture.logger};
+    fillTracker(fixture, tracker, state.range(0));
+    const std::vector<std::size_t> roots = tracker.getCalcRoots();
+    std::size_t collected = 0;
+    for (auto _ : state) {
+        const std::vector<Change> order = tracker.collectSubtrees(roots);
+        collected = order.size();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(collected));
+}
+BENCHMARK(BM_CollectSubtrees)->Arg(1000)->Arg(10000);
+
+// discarding a large pending set, every removal looks the change up and drops its key entries
+static void BM_TrackerRemove(benchmark::State& state) {
+    Bench::Fixture fixture{Bench::Fixture::withParts(10000)};
+    for (auto _ : state) {
+        state.PauseTiming();
+        ChangeTracker tracker{fixture.dbService, fixture.logger};
+        fillTracker(fixture, tracker, state.range(0));
+        const std::unordered_set<std::size_t> roots = tracker.getRoots();
+        const Change::chHashV keys{roots.begin(), roots.end()};
+        state.ResumeTiming();
+
+        tracker.removeChanges(keys);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TrackerRemove)->Arg(1000)->Arg(20000)->Unit(benchmark::kMillisecond);
+
+// validation and required changes of one generated change, the per row work of an import
+static void BM_PrepareChange(benchmark::State& state) {
+    Bench::Fixture fixture{Bench::Fixture::withParts(10000)};
+    ChangeTracker tracker{fixture.dbService, fixture.logger};
+    tracker.setMaxPKeys(fixture.data->maxPKeys);
+    const ImTable table = fixture.dbService.getTable(InventoryGenerator::PARTS_TABLE);
+    const Change change{Bench::newPart(*fixture.data, 0), ChangeType::INSERT_ROW, table};
+    const DbSnapshot db = fixture.dbService.getSnapshot();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tracker.prepareChange(db, change));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PrepareChange);
@@ -0,0 +1,23 @@
+#include "benchData.hpp"
+#include "dbFilter.hpp"
+
+#include <benchmark/benchmark.h>
+
+// a keyword search end to end: scheduled on the pool, polled like the ui does every frame
+static void BM_FilterKeyword(benchmark::State& state) {
+    Bench::Fixture fixture{Bench::Fixture::withParts(static_cast<std::size_t>(state.range(0)))};
+    UI::DataStates dataStates;
+    dataStates.dbData = UI::DataState::DATA_READY;
+    DbFilter filter{fixture.dbService, fixture.pool, fixture.logger, dataStates};
+    filter.setData(fixture.data);
+
+    for (auto _ : state) {
+        filter.startFilterSearch("capacitor 0805", 0.3f);
+        while (!filter.dataReady()) {
+            std::this_thread::yield();
+        }
+        benchmark::DoNotOptimize(filter.getFilteredData());
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(fixture.totalRows()));
+}
+BENCHMARK(BM_FilterKeyword)->Arg(10000)->Arg(100000)->UseRealTime();
@@ -0,0 +1,336 @@
+#include "autoInv.hpp"
+#include "benchData.hpp"
+#include "changeTracker.hpp"
+#include "csvReader.hpp"
+#include "partApi.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+
+static void BM_ReadCsv(benchmark::State& state) {
+    Logger logger;
+    logger.setMinLevel(LogLevel::ERR);
+    GeneratorOptions options;
+    options.bomRows = static_cast<std::size_t>(state.range(0));
+    options.orderRows = 0;
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "inventoryBenchBom.csv";
+    writeData(path, InventoryGenerator{options}.getBom(), logger);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(readData(path, logger));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_ReadCsv)->Arg(1000)->Arg(100000);
+
+// the reader alone, fields stay views into the mapping
+static void BM_CsvReaderChunks(benchmark::State& state) {
+    Logger logger;
+    logger.setMinLevel(LogLevel::ERR);
+    GeneratorOptions options;
+    options.bomRows = static_cast<std::size_t>(state.range(0));
+    options.orderRows = 0;
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "inventoryBenchChunks.csv";
+    writeData(path, InventoryGenerator{options}.getBom(), logger);
+
+    std::size_t bytes = 0;
+    for (auto _ : state) {
+        CsvReader reader{logger};
+        reader.open(path);
+        CsvChunk chunk;
+        while (reader.nextChunk(chunk, 4096)) {
+            benchmark::DoNotOptimize(chunk.fields.data());
+        }
+        bytes = reader.getSize();
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(bytes));
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_CsvReaderChunks)->Arg(100000)->Arg(1000000);
+
+static void BM_AddChanges(benchmark::State& state) {
+    Bench::Fixture fixture{Bench::Fixture::withParts(10000)};
+    const ImTable table = fixture.dbService.getTable(InventoryGenerator::PARTS_TABLE);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        ChangeTracker tracker{fixture.dbService, fixture.logger};
+        tracker.setMaxPKeys(fixture.data->maxPKeys);
+        state.ResumeTiming();
+
+        for (int64_t i = 0; i < state.range(0); ++i) {
+            Change change{Bench::newPart(*fixture.data, static_cast<std::size_t>(i)), ChangeType::INSERT_ROW, table};
+            benchmark::DoNotOptimize(tracker.addChange(std::move(change)));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_AddChanges)->Arg(100)->Arg(1000);
+
+// the same changes through addChanges, one lock and one validity pass for all of them
+static void BM_AddChangesBatch(benchmark::State& state) {
+    Bench::Fixture fixture{Bench::Fixture::withParts(10000)};
+    const ImTable table = fixture.dbService.getTable(InventoryGenerator::PARTS_TABLE);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        ChangeTracker tracker{fixture.dbService, fixture.logger};
+        tracker.setMaxPKeys(fixture.data->maxPKeys);
+        std::vector<Change> changes;
+        changes.reserve(static_cast<std::size_t>(state.range(0)));
+        for (int64_t i = 0; i < state.range(0); ++i) {
+            changes.emplace_back(Bench::newPart(*fixture.data, static_cast<std::size_t>(i)), ChangeType::INSERT_ROW, table);
+        }
+        state.ResumeTiming();
+
+        benchmark::DoNotOptimize(tracker.addChanges(changes));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_AddChangesBatch)->Arg(100)->Arg(1000);
+
+// aborting an import: the whole batch is one journal entry, undoing it only touches what the import added
+static void BM_UndoImport(benchmark::State& state) {
+    Bench::Fixture fixture{Bench::Fixture::withParts(10000)};
+    const ImTable table = fixture.dbService.getTable(InventoryGenerator::PARTS_TABLE);
+    ChangeTracker tracker{fixture.dbService, fixture.logger};
+    tracker.setMaxPKeys(fixture.data->maxPKeys);
+    std::vector<Change> changes;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        changes.emplace_back(Bench::newPart(*fixture.data, static_cast<std::size_t>(i)), ChangeType::INSERT_ROW, table);
+    }
+    {
+        ChangeTracker::JournalGroup import{tracker};
+        tracker.addChanges(changes);
+    }
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tracker.undo());
+        state.PauseTiming();
+        tracker.redo();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_UndoImport)->Arg(1000)->Arg(5000)->Unit(benchmark::kMillisecond);
+
+// starting up after a crash: replaying the change log of an import and checking it against the snapshot
+static void BM_RecoverChangeLog(benchmark::State& state) {
+    Bench::Fixture fixture{Bench::Fixture::withParts(10000)};
+    const ImTable table = fixture.dbService.getTable(InventoryGenerator::PARTS_TABLE);
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "inventoryBenchChanges.log";
+    std::filesystem::remove(path);
+    std::size_t changeCount = 0;
+    {
+        ChangeTracker tracker{fixture.dbService, fixture.logger};
+        tracker.setMaxPKeys(fixture.data->maxPKeys);
+        tracker.openChangeLog(path);
+        std::vector<Change> changes;
+        for (int64_t i = 0; i < state.range(0); ++i) {
+            changes.emplace_back(Bench::newPart(*fixture.data, static_cast<std::size_t>(i)), ChangeType::INSERT_ROW, table);
+        }
+        tracker.addChanges(changes);
+        changeCount = tracker.getSnapShot()->changeCount();
+    }
+
+    for (auto _ : state) {
+        ChangeTracker tracker{fixture.dbService, fixture.logger};
+        tracker.setMaxPKeys(fixture.data->maxPKeys);
+        benchmark::DoNotOptimize(tracker.openChangeLog(path));
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(changeCount));
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_RecoverChangeLog)->Arg(1000)->Arg(5000)->Unit(benchmark::kMillisecond);
+
+namespace {
+constexpr std::size_t CHAIN_ROWS = 4; // pending rows per table, each referenced by several rows of every table above
+
+std::string chainName(const std::string& table, std::size_t index) {
+    return std::format("{}-chain-{}", table, index % CHAIN_ROWS);
+}
+
+// the generated schema, except rows below parts need a description, so the rows a change generates start out invalid
+std::shared_ptr<const CompleteDbData> describedChainData(const CompleteDbData& data) {
+    auto chainData = std::make_shared<CompleteDbData>(data);
+    for (auto& [table, headers] : chainData->headers) {
+        if (table == InventoryGenerator::PARTS_TABLE) { continue; }
+        for (HeaderInfo& header : headers.data) {
+            if (header.name == "description") { header.nullable = false; }
+        }
+    }
+    return chainData;
+}
+
+// Every table but the leaves gets CHAIN_ROWS inserts, lowest level first. Each references rows pending one level below,
+// the leaves are generated without description. The result is one invalid DAG `depth` levels deep with every path
+// from a leaf to parts, doubling per level at fanout 2.
+void fillChain(Bench::Fixture& fixture, ChangeTracker& tracker, std::vector<std::string>& leaves) {
+    const CompleteDbData& data = *fixture.data;
+    std::vector<std::string> tables = data.tables;
+    std::ranges::sort(tables, {}, [&](const std::string& table) { return data.headers.at(table).maxDepth; });
+    tracker.setMaxPKeys(data.maxPKeys);
+    for (const std::string& tableName : tables) {
+        const HeadersInfo& headers = data.headers.at(tableName);
+        if (headers.maxDepth == 0) {
+            leaves.push_back(tableName);
+            continue;
+        }
+        const ImTable table = fixture.dbService.getTable(tableName);
+        for (std::size_t i = 0; i < CHAIN_ROWS; ++i) {
+            Change::colValMap cells{{"name", chainName(tableName, i)}, {"description", "bench"}};
+            if (tableName == InventoryGenerator::PARTS_TABLE) { cells.emplace(InventoryGenerator::QUANTITY_COLUMN, "10"); }
+            std::size_t offset = i;
+            for (const HeaderInfo& header : headers.data) {
+                if (header.type != DB::HeaderTypes::FOREIGN_KEY) { continue; }
+                cells.emplace(header.name, chainName(header.referencedTable, ++offset));
+            }
+            tracker.addChange(Change{std::move(cells), ChangeType::INSERT_ROW, table});
+        }
+    }
+}
+
+// Validity recounted from scratch, without the tracker's counters: a change with children is valid exactly when all of
+// its pending children are, one without keeps its own.
+bool recountValidity(const std::unordered_map<std::size_t, const Change*>& changes,
+                     std::size_t key,
+                     std::unordered_map<std::size_t, bool>& recounted) {
+    if (const auto it = recounted.find(key); it != recounted.end()) { return it->second; }
+    const Change& change = *changes.at(key);
+    bool valid = change.isValid();
+    if (change.hasChildren()) {
+        valid = true;
+        for (const std::size_t childKey : change.getChildren()) {
+            if (changes.contains(childKey) && !recountValidity(changes, childKey, recounted)) { valid = false; }
+        }
+    }
+    recounted.emplace(key, valid);
+    return valid;
+}
+
+// describes the first change whose validity differs from its recount, empty if none does
+std::string findValidityMismatch(const uiChangeInfo& snapshot) {
+    std::unordered_map<std::size_t, const Change*> changes;
+    for (const auto& [name, table] : snapshot.tables) {
+        for (const auto& [key, change] : table->changes) {
+            changes.emplace(key, &change);
+        }
+    }
+    std::unordered_map<std::size_t, bool> recounted;
+    for (const auto& [key, change] : changes) {
+        if (change->isValid() != recountValidity(changes, key, recounted)) {
+            return std::format("change {} of {} is {}valid, recounted it is not", key, change->getTable(), change->isValid() ? "" : "in");
+        }
+    }
+    return "";
+}
+} // namespace
+
+// Completes the generated leaves of a deep, shared DAG one update at a time. Each completion flips validity above it
+// only where a row's last invalid child became valid, the depth is the argument.
+static void BM_CompleteSharedChain(benchmark::State& state) {
+    GeneratorOptions options;
+    options.parts = 100;
+    options.rowsPerTable = 20;
+    options.depth = static_cast<std::size_t>(state.range(0));
+    options.fanout = 2;
+    Bench::Fixture fixture{options};
+    fixture.dbService.injectData(describedChainData(*fixture.data));
+    fixture.dbService.getCompleteData();
+
+    std::size_t completed = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        ChangeTracker tracker{fixture.dbService, fixture.logger};
+        std::vector<std::string> leaves;
+        fillChain(fixture, tracker, leaves);
+        const std::shared_ptr<const uiChangeInfo> snapshot = tracker.getSnapShot();
+        std::vector<std::pair<ImTable, uint32_t>> updates;
+        for (const std::string& leaf : leaves) {
+            for (const auto& [rowId, key] : snapshot->getTable(leaf)->idMappedChanges) {
+                updates.emplace_back(fixture.dbService.getTable(leaf), rowId);
+            }
+        }
+        state.ResumeTiming();
+
+        for (const auto& [table, rowId] : updates) {
+            Change update{Change::colValMap{{"description", "done"}}, ChangeType::UPDATE_CELLS, table};
+            benchmark::DoNotOptimize(tracker.addChange(std::move(update), rowId));
+
+            state.PauseTiming();
+            const std::string mismatch = findValidityMismatch(*tracker.getSnapShot());
+            state.ResumeTiming();
+            if (!mismatch.empty()) {
+                const std::string error = std::format("after completing row {} of {}: {}", rowId, table.name, mismatch);
+                state.SkipWithError(error.c_str());
+                return;
+            }
+        }
+        completed = updates.size();
+
+        state.PauseTiming();
+        const std::shared_ptr<const uiChangeInfo> completedSnapshot = tracker.getSnapShot();
+        state.ResumeTiming();
+        for (const std::size_t root : completedSnapshot->roots) {
+            if (completedSnapshot->getChange(root).isValid()) { continue; }
+            const std::string error = std::format("root {} is still invalid after all leaves were completed", root);
+            state.SkipWithError(error.c_str());
+            return;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(completed));
+}
+BENCHMARK(BM_CompleteSharedChain)->Arg(4)->Arg(8)->Arg(12)->Unit(benchmark::kMillisecond);
+
+// a whole bom import: rows are prepared side by side on the cpu lane, then merged into the tracker batch by batch
+static void BM_ImportBom(benchmark::State& state) {
+    GeneratorOptions options = Bench::Fixture::withParts(10000);
+    options.bomRows = static_cast<std::size_t>(state.range(0));
+    options.orderRows = 0;
+    Bench::Fixture fixture{options};
+    PartApi partApi{fixture.pool, fixture.config, fixture.logger};
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::ofstream{directory / "inventoryBenchImport.json"} << std::format(
+        R"({{"dbname":"","user":"","password":"","quantity-column":"{}","api":{{"address":"","key":"","search":{{}}}}}})",
+        InventoryGenerator::QUANTITY_COLUMN);
+    fixture.config.setConfigString(directory / "inventoryBenchImport.json");
+    const InventoryGenerator generator{options};
+    const CSV::Data& bom = generator.getBom();
+    writeData(directory / "inventoryBenchImport.csv", bom, fixture.logger);
+
+    // part columns plus every referenced table by its unique key, like a saved bom mapping
+    std::vector<AutoInv::SerializableMapping> mappings;
+    auto map = [&](const std::string& column, const std::string& table, const std::string& header) {
+        mappings.emplace_back(AutoInv::MappingCsvToDb{AutoInv::PreciseMapLocation{column, ""}, AutoInv::PreciseMapLocation{table, header}},
+                              AutoInv::SourceType::CSV);
+    };
+    map("Part Number", InventoryGenerator::PARTS_TABLE, "name");
+    map("Quantity", InventoryGenerator::PARTS_TABLE, InventoryGenerator::QUANTITY_COLUMN);
+    map("Description", InventoryGenerator::PARTS_TABLE, "description");
+    const std::vector<std::string>& header = bom.rows.front();
+    for (auto column = header.begin() + 4; column != header.end(); ++column) {
+        map(*column, InventoryGenerator::PARTS_TABLE, *column + "_id");
+        map(*column, *column, "name");
+    }
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        ChangeTracker tracker{fixture.dbService, fixture.logger};
+        tracker.setMaxPKeys(fixture.data->maxPKeys);
+        AutoInv::ChangeGeneratorFromBom bomImport{fixture.pool, tracker, fixture.dbService, partApi, fixture.config, fixture.logger};
+        bomImport.setData(fixture.data);
+        state.ResumeTiming();
+
+        benchmark::DoNotOptimize(bomImport.importCsv(directory / "inventoryBenchImport.csv", mappings).get());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    std::filesystem::remove(directory / "inventoryBenchImport.csv");
+    std::filesystem::remove(directory / "inventoryBenchImport.json");
+}
+BENCHMARK(BM_ImportBom)->Arg(5000)->Arg(50000)->Unit(benchmark::kMillisecond)->UseRealTime();
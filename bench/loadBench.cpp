@@ -0,0 +1,32 @@
+#include "benchData.hpp"
+
+#include <benchmark/benchmark.h>
+
+// what happens on the workers after the rows arrived: validation and max primary keys, then publishing
+
+static void BM_ValidateSnapshot(benchmark::State& state) {
+    Bench::Fixture fixture{Bench::Fixture::withParts(static_cast<std::size_t>(state.range(0)))};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fixture.dbService.validateCompleteDbData(*fixture.data));
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(fixture.totalRows()));
+}
+BENCHMARK(BM_ValidateSnapshot)->Arg(10000)->Arg(100000);
+
+static void BM_CalcMaxPKeys(benchmark::State& state) {
+    Bench::Fixture fixture{Bench::Fixture::withParts(static_cast<std::size_t>(state.range(0)))};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fixture.dbService.calcMaxPKeys(*fixture.data));
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(fixture.totalRows()));
+}
+BENCHMARK(BM_CalcMaxPKeys)->Arg(10000)->Arg(100000);
+
+static void BM_PublishSnapshot(benchmark::State& state) {
+    Bench::Fixture fixture{Bench::Fixture::withParts(10000)};
+    for (auto _ : state) {
+        fixture.dbService.injectData(fixture.data);
+        benchmark::DoNotOptimize(fixture.dbService.getCompleteData());
+    }
+}
+BENCHMARK(BM_PublishSnapshot);
@@ -1,92 +1,76 @@
 #include "autoInv.hpp"
 #include "autoGenInfo.hpp"
+#include "metrics.hpp"
+
+#include <deque>
+#include <numeric>
+#include <random>
 
 #define EXCLUDE_API_FAILS
 
-std::vector<std::string> parseLine(const std::string& line) {
-    // https://stackoverflow.com/users/25450/sastanin
-    enum class csvState { UNQUOTED_FIELD, QUOTED_FIELD, QUOTED_QUOTE };
-
-    csvState state = csvState::UNQUOTED_FIELD;
-    std::vector<std::string> fields{""};
-    size_t i = 0; // index of the current field
-    for (char c : line) {
-        switch (state) {
-        case csvState::UNQUOTED_FIELD:
-            switch (c) {
-            case ',': // end of field
-                fields.push_back("");
-                i++;
-                break;
-            case '"':
-                state = csvState::QUOTED_FIELD;
-                break;
-            default:
-                fields[i].push_back(c);
-                break;
-            }
-            break;
-        case csvState::QUOTED_FIELD:
-            switch (c) {
-            case '"':
-                state = csvState::QUOTED_QUOTE;
-                break;
-            default:
-                fields[i].push_back(c);
-                break;
-            }
-            break;
-        case csvState::QUOTED_QUOTE:
-            switch (c) {
-            case ',': // , after closing quote
-                fields.push_back("");
-                i++;
-                state = csvState::UNQUOTED_FIELD;
-                break;
-            case '"': // "" -> "
-                fields[i].push_back('"');
-                state = csvState::QUOTED_FIELD;
-                break;
-            default: // end of quote
-                state = csvState::UNQUOTED_FIELD;
-                break;
+namespace {
+constexpr std::size_t CSV_CHUNK_ROWS = 4096;
+constexpr std::size_t PIPELINE_BATCH_ROWS = 256; // small, so the first changes show up early
+constexpr std::size_t PIPELINE_MIN_DEPTH = 2;    // batches enriched at once, at least one per io worker
+constexpr std::size_t PREPARE_CHUNK_ROWS = 64;    // rows per preparation task, a batch spreads over the cpu lane
+constexpr std::size_t TYPE_CHUNK_ROWS = 8192;     // rows per type inference task
+constexpr uint32_t TYPE_SAMPLE_SEED = 42;         // fixed, so a file always gets the same types
+
+// equally long rows including the header, empty on failure
+std::vector<std::vector<std::string>> readRows(const std::filesystem::path& csv, Logger& logger) {
+    CsvReader reader{logger};
+    if (!reader.open(csv)) { return {}; }
+
+    std::vector<std::vector<std::string>> rows;
+    CsvChunk chunk;
+    while (reader.nextChunk(chunk, CSV_CHUNK_ROWS)) {
+        for (std::size_t r = 0; r < chunk.rowCount(); ++r) {
+            const std::span<const std::string_view> fields = chunk.row(r);
+            if (!rows.empty() && fields.size() != rows.front().size()) {
+                logger.pushLog(Log{std::format("ERROR: CSV parsing failed: Row {} has different length ({} vs {}).",
+                                               chunk.firstRow + r,
+                                               fields.size(),
+                                               rows.front().size())});
+                return {};
             }
-            break;
+            rows.emplace_back(fields.begin(), fields.end());
         }
     }
-    return fields;
+    if (reader.failed()) { return {}; }
+    if (rows.empty()) { logger.pushLog(Log{std::format("ERROR: CSV file '{}' is empty.", csv.string())}); }
+    return rows;
 }
 
-CSV::Data readData(std::filesystem::path csv, Logger& logger) {
-    std::ifstream file(csv);
-    if (!file.is_open()) {
-        logger.pushLog(Log{std::format("ERROR: Failed to open CSV file: {}", csv.string())});
-        return CSV::Data{};
-    }
-    std::string line;
-    std::size_t prevCols = 0;
-    std::size_t i = 0;
-    std::vector<std::vector<std::string>> rows;
-
-    while (std::getline(file, line)) {
-        std::vector<std::string> row = parseLine(line);
-        std::size_t cols = row.size();
-        if (cols == 0) {
-            logger.pushLog(Log{std::format("ERROR: CSV parsing failed: Row {} is empty.", i)});
-            return CSV::Data{};
-        }
-        if (i > 0 && cols != prevCols) {
-            logger.pushLog(Log{std::format("ERROR: CSV parsing failed: Row {} has different length ({} vs {}).", i, cols, prevCols)});
-            return CSV::Data{};
+// the rows type inference looks at, empty means all of them
+std::vector<std::size_t> typeSampleRows(std::size_t rowCount, const CSV::TypeSampling& sampling) {
+    const std::size_t dataRows = rowCount - 1;
+    if ((sampling.headRows == 0 && sampling.sampledRows == 0) || dataRows <= sampling.headRows + sampling.sampledRows) { return {}; }
+    std::vector<std::size_t> rows(sampling.headRows);
+    std::iota(rows.begin(), rows.end(), std::size_t{1});
+
+    // reservoir over the rest, every row after the head is kept with the same chance
+    std::mt19937 engine{TYPE_SAMPLE_SEED};
+    std::vector<std::size_t> reservoir;
+    reservoir.reserve(sampling.sampledRows);
+    for (std::size_t row = sampling.headRows + 1; row < rowCount; ++row) {
+        const std::size_t seen = row - sampling.headRows - 1;
+        if (seen < sampling.sampledRows) {
+            reservoir.push_back(row);
+            continue;
         }
-        prevCols = cols;
-        rows.push_back(std::move(row));
-        ++i;
-    }
-    if (rows.empty()) {
-        logger.pushLog(Log{std::format("ERROR: CSV file '{}' is empty.", csv.string())});
-        return CSV::Data{};
+        const std::size_t slot = engine() % (seen + 1);
+        if (slot < sampling.sampledRows) { reservoir[slot] = row; }
     }
+    std::sort(reservoir.begin(), reservoir.end()); // front to back through memory
+    rows.insert(rows.end(), reservoir.begin(), reservoir.end());
+    return rows;
+}
+} // namespace
+
+CSV::Data readData(std::filesystem::path csv, Logger& logger) {
+    METRIC_TIMER("csv.readData");
+    std::vector<std::vector<std::string>> rows = readRows(csv, logger);
+    if (rows.empty()) { return CSV::Data{}; }
     std::vector<DB::TypeCategory> types = CSV::determineTypes(rows);
     if (types.empty()) {
         logger.pushLog(Log{"ERROR: Failed to determine CSV column types."});
@@ -96,7 +80,7 @@ CSV::Data readData(std::filesystem::path csv, Logger& logger) {
 }
 
 std::string escapeCsvField(const std::string& field) {
-    bool needsQuotes = field.find_first_of(",\"\n") != std::string::npos;
+    bool needsQuotes = field.find_first_of(",\"\r\n") != std::string::npos;
     if (!needsQuotes) { return field; }
 
     std::string escaped = "\"";
@@ -130,6 +114,61 @@ bool writeData(std::filesystem::path csv, const CSV::Data& data, Logger& logger)
 }
 
 using namespace AutoInv;
+CsvBatchSource::CsvBatchSource(Logger& cLogger) : logger_(cLogger), reader_(cLogger) {}
+
+CsvBatchSource::CsvBatchSource(Logger& cLogger, const std::vector<std::vector<std::string>>& cRows)
+    : logger_(cLogger), loaded_(&cRows), reader_(cLogger) {}
+
+bool CsvBatchSource::open(const std::filesystem::path& csv) {
+    if (!reader_.open(csv)) { return false; }
+    if (!reader_.nextChunk(chunk_, 1)) {
+        if (!reader_.failed()) { logger_.pushLog(Log{std::format("ERROR: CSV file '{}' is empty.", csv.string())}); }
+        return false;
+    }
+    const std::span<const std::string_view> header = chunk_.row(0);
+    header_.assign(header.begin(), header.end());
+    return true;
+}
+
+const std::vector<std::string>& CsvBatchSource::getHeader() const {
+    return loaded_ ? loaded_->front() : header_;
+}
+
+std::optional<CsvBatch> CsvBatchSource::next(std::size_t maxRows) {
+    METRIC_TIMER("csv.parseBatch");
+    CsvBatch batch;
+    batch.firstRow = nextRow_;
+    if (loaded_) {
+        if (nextRow_ >= loaded_->size()) { return std::nullopt; }
+        batch.rows = std::span(*loaded_).subspan(nextRow_, std::min(maxRows, loaded_->size() - nextRow_));
+    } else {
+        if (failed_ || !reader_.nextChunk(chunk_, maxRows)) {
+            failed_ = failed_ || reader_.failed();
+            return std::nullopt;
+        }
+        batch.storage.reserve(chunk_.rowCount());
+        for (std::size_t r = 0; r < chunk_.rowCount(); ++r) {
+            const std::span<const std::string_view> fields = chunk_.row(r);
+            if (fields.size() != header_.size()) {
+                logger_.pushLog(Log{std::format("ERROR: CSV parsing failed: Row {} has different length ({} vs {}).",
+                                                chunk_.firstRow + r,
+                                                fields.size(),
+                                                header_.size())});
+                failed_ = true;
+                return std::nullopt;
+            }
+            batch.storage.emplace_back(fields.begin(), fields.end());
+        }
+        batch.rows = batch.storage;
+    }
+    nextRow_ += batch.rows.size();
+    return batch;
+}
+
+bool CsvBatchSource::failed() const {
+    return failed_;
+}
+
 CsvChangeGenerator::CsvChangeGenerator(ThreadPool& cThreadPool,
                                        ChangeTracker& cChangeTracker,
                                        DbService& cDbService,
@@ -140,55 +179,114 @@ CsvChangeGenerator::CsvChangeGenerator(ThreadPool& cThreadPool,
     : pool_(cThreadPool), changeTracker_(cChangeTracker), dbService_(cDbService), partApi_(cPartApi), config_(cConfig), logger_(cLogger),
       operation_(cOperation) {}
 
-bool CsvChangeGenerator::run(std::filesystem::path csv) {
-    csvData_ = readData(csv, logger_);
-    bool success = !csvData_.rows.empty();
-    if (success) { lastSuccessfulCsvPath_ = csv; }
-    return success;
+Task<bool> CsvChangeGenerator::run(std::filesystem::path csv) {
+    co_await pool_.schedule(TaskLane::CPU, TaskPriority::NORMAL);
+    TraceSpan span{logger_, TraceEvent::IMPORT_READ};
+    csvData_ = CSV::Data{readRows(csv, logger_), {}};
+    span.setEndArg(csvData_.rows.size());
+    if (csvData_.rows.empty()) { co_return false; }
+
+    csvData_.columnTypes = co_await inferColumnTypes();
+    if (csvData_.columnTypes.empty()) {
+        logger_.pushLog(Log{"ERROR: Failed to determine CSV column types."});
+        co_return false;
+    }
+    lastSuccessfulCsvPath_ = csv;
+    co_return true;
 }
 
-void CsvChangeGenerator::convertMappings(ChangeConvertedMapping& convertedMapping,
-                                         std::unordered_set<std::string>& foundTables,
-                                         const std::vector<MappingCsvToDb>& mappings,
-                                         SourceType source) {
-    const std::vector<std::string>& csvHeader = csvData_.rows[0];
+Task<std::vector<DB::TypeCategory>> CsvChangeGenerator::inferColumnTypes() {
+    METRIC_TIMER("csv.inferColumnTypes");
+    const std::vector<std::vector<std::string>>& rows = csvData_.rows;
+    const std::vector<std::size_t> sample = typeSampleRows(rows.size(), config_.getTypeSampling());
+    const std::size_t rowCount = sample.empty() ? rows.size() - 1 : sample.size();
+
+    // chunks of rows with all their columns, the rows are stored row by row
+    std::vector<Task<std::vector<DB::TypeCategory>>> chunks;
+    for (std::size_t start = 0; start < rowCount; start += TYPE_CHUNK_ROWS) {
+        const std::size_t end = std::min(rowCount, start + TYPE_CHUNK_ROWS);
+        chunks.push_back(pool_.spawn(TaskLane::CPU, TaskPriority::NORMAL, [&rows, &sample, start, end] {
+            std::vector<DB::TypeCategory> types(rows.front().size(), DB::TypeCategory::OTHER);
+            for (std::size_t i = start; i < end; ++i) {
+                CSV::widenTypes(rows[sample.empty() ? i + 1 : sample[i]], types);
+            }
+            return types;
+        }));
+    }
 
-    for (const MappingCsvToDb& mapping : mappings) {
-        // check legality of mapping
-        const auto it =
-            std::find_if(csvHeader.begin(), csvHeader.end(), [&](const std::string& col) { return mapping.source.outerIdentifier == col; });
-        if (it == csvHeader.end()) {
-            logger_.pushLog(Log{
-                std::format("ERROR: Converting mappings failed because {} does not match a csv column.", mapping.source.outerIdentifier)});
-            return;
+    // rows and sample stay in this frame until every chunk is done
+    std::vector<DB::TypeCategory> types(rows.front().size(), DB::TypeCategory::OTHER);
+    for (const std::vector<DB::TypeCategory>& chunkTypes : co_await pool_.whenAll(std::move(chunks))) {
+        for (std::size_t j = 0; j < types.size(); ++j) {
+            types[j] = CSV::widenType(types[j], chunkTypes[j]);
         }
-
-        // store found tables to construct changes later
-        std::size_t j = std::distance(csvHeader.begin(), it);
-        if (!foundTables.contains(mapping.destination.outerIdentifier)) { foundTables.insert(mapping.destination.outerIdentifier); }
-
-        // csv column references new db header
-        convertedMapping.preciseHeaders.try_emplace(j, TargetData{std::vector<PreciseMapLocationCombined>{}});
-
-        // prepare cells for later use
-        convertedMapping.cells.try_emplace(mapping.destination.outerIdentifier,
-                                           TableCells{mapping.destination.outerIdentifier, Change::colValMap{}});
-
-        // add mapping-destination to the csv header (1 to n)
-        convertedMapping.preciseHeaders[j].dbHeaders.push_back(PreciseMapLocationCombined(mapping.destination, source));
-        convertedMapping.columnIndexes.push_back(j);
     }
+    co_return types;
 }
 
-ChangeConvertedMapping CsvChangeGenerator::convertMapping() {
-    // gets the indexes of mapped csv-columns and an indexmapped table
-    ChangeConvertedMapping convertedMapping;
-    std::unordered_set<std::string> foundTables;
+MappingPlan CsvChangeGenerator::compileMappings(const DbSnapshot& db) const {
+    const std::vector<std::string>& csvHeader = csvData_.rows[0];
+    const HeaderMap& headers = db.getData().headers;
+
+    // destinations grouped by csv column in order of first appearance, csv sourced ones first
+    std::vector<std::size_t> columns;
+    std::unordered_map<std::size_t, std::vector<std::pair<std::string, MappingPlan::Cell>>> targets;
+    auto collect = [&](const std::vector<MappingCsvToDb>& mappings, SourceType source) {
+        for (std::size_t m = 0; m < mappings.size(); ++m) {
+            const MappingCsvToDb& mapping = mappings[m];
+            const auto it = std::find(csvHeader.begin(), csvHeader.end(), mapping.source.outerIdentifier);
+            if (it == csvHeader.end()) {
+                logger_.pushLog(Log{std::format("ERROR: Converting mappings failed because {} does not match a csv column.",
+                                                mapping.source.outerIdentifier)});
+                return;
+            }
+            const std::size_t column = std::distance(csvHeader.begin(), it);
+            auto [target, inserted] = targets.try_emplace(column);
+            if (inserted) { columns.push_back(column); }
+            const std::size_t index = source == SourceType::API ? m : column;
+            MappingPlan::Cell cell{ColumnName{mapping.destination.innerIdentifier}, source, index};
+            target->second.emplace_back(mapping.destination.outerIdentifier, std::move(cell));
+        }
+    };
+    collect(directMappings_, SourceType::CSV);
+    collect(indirectApiMappings_, SourceType::API);
+
+    MappingPlan plan;
+    std::unordered_map<std::string, std::size_t> tableSlots;
+    for (std::size_t column : columns) {
+        for (auto& [table, cell] : targets.at(column)) {
+            if (!headers.contains(table)) {
+                logger_.pushLog(Log{std::format("ERROR: Converting mappings failed because {} is not a database table.", table)});
+                continue;
+            }
+            auto [slot, inserted] = tableSlots.try_emplace(table, plan.tables.size());
+            if (inserted) { plan.tables.push_back(MappingPlan::Table{table, {}, {}}); }
 
-    convertMappings(convertedMapping, foundTables, directMappings_, SourceType::CSV);
-    convertMappings(convertedMapping, foundTables, indirectApiMappings_, SourceType::API);
+            // the first mapping of a db column wins
+            std::vector<MappingPlan::Cell>& cells = plan.tables[slot->second].cells;
+            if (std::none_of(cells.begin(), cells.end(), [&](const MappingPlan::Cell& c) { return c.column == cell.column; })) {
+                cells.push_back(std::move(cell));
+            }
+        }
+    }
 
-    return convertedMapping;
+    for (MappingPlan::Table& table : plan.tables) {
+        for (const HeaderInfo& header : headers.at(table.name).data) {
+            if (header.nullable || header.type == DB::HeaderTypes::PRIMARY_KEY) { continue; }
+            if (std::any_of(table.cells.begin(), table.cells.end(), [&](const MappingPlan::Cell& c) { return c.column == header.name; })) {
+                continue;
+            }
+            table.required.emplace_back(header.name);
+        }
+        plan.placeholders += table.required.size();
+    }
+    plan.firstPlaceholder = missingParam_;
+    std::sort(plan.tables.begin(), plan.tables.end(), [&](const MappingPlan::Table& a, const MappingPlan::Table& b) {
+        const std::size_t depthA = headers.at(a.name).maxDepth;
+        const std::size_t depthB = headers.at(b.name).maxDepth;
+        return std::tie(depthA, a.name) < std::tie(depthB, b.name);
+    });
+    return plan;
 }
 
 const MappingCsvApi& CsvChangeGenerator::findApiSource(MappingIdType mappingId) const {
@@ -216,210 +314,213 @@ std::string CsvChangeGenerator::getJsonTarget(const nlohmann::json& j, const std
     }
 }
 
-void CsvChangeGenerator::fetchChunk(std::span<std::vector<std::string>> chunk,
-                                    std::span<std::unordered_map<std::string, Change::colValMap>> resultChunk,
-                                    std::size_t chunkStart) {
-    if (resultChunk.size() != chunk.size()) { return; }
-    for (std::size_t j = 0; j < chunk.size(); ++j) {
-        resultChunk[j] = std::unordered_map<std::string, Change::colValMap>{};
-        const std::vector<std::string>& row = chunk[j];
-        for (const MappingCsvToDb& mapping : indirectApiMappings_) {
-            // gets index of column to search with
-            auto itHeaderIndex = std::find(csvData_.rows[0].begin(), csvData_.rows[0].end(), mapping.source.outerIdentifier);
-            if (itHeaderIndex == csvData_.rows[0].end()) { return; }
-            std::size_t itCsvIndex = itHeaderIndex - csvData_.rows[0].begin();
-            std::string jsonTarget = getJsonTarget(partApi_.fetchDataPoint(chunk[j][itCsvIndex]), mapping.source.innerIdentifier);
-
+CsvBatch CsvChangeGenerator::enrichBatch(CsvBatch batch) {
+    TraceSpan span{logger_, TraceEvent::API_FETCH, batch.rows.size()};
+    METRIC_TIMER("csv.enrichBatch");
+    const std::size_t apiSlots = indirectApiMappings_.size();
+    batch.apiValues.assign(batch.rows.size() * apiSlots, std::string{});
+    batch.apiFailed.assign(batch.rows.size(), false);
+    const std::vector<std::string>& header = csvData_.rows.front();
+    for (std::size_t m = 0; m < apiSlots; ++m) {
+        const MappingCsvToDb& mapping = indirectApiMappings_[m];
+        // gets index of column to search with
+        auto itHeaderIndex = std::find(header.begin(), header.end(), mapping.source.outerIdentifier);
+        if (itHeaderIndex == header.end()) { continue; } // compileMappings reported it already
+        const std::size_t csvIndex = itHeaderIndex - header.begin();
+
+        for (std::size_t j = 0; j < batch.rows.size(); ++j) {
+            std::string jsonTarget = getJsonTarget(partApi_.fetchDataPoint(batch.rows[j][csvIndex]), mapping.source.innerIdentifier);
 #ifdef EXCLUDE_API_FAILS
             if (jsonTarget.empty()) {
                 // api doesnt contain this path, add to list of failed
-                std::lock_guard<std::mutex> lg{failedCsvApiMtx_};
-                failedCsvApiRows_.insert(chunkStart + j);
+                batch.apiFailed[j] = true;
                 continue;
             }
 #endif
-
-            resultChunk[j].try_emplace(mapping.destination.outerIdentifier, Change::colValMap{});
-            resultChunk[j].at(mapping.destination.outerIdentifier).emplace(mapping.destination.innerIdentifier, jsonTarget);
+            batch.apiValues[j * apiSlots + m] = std::move(jsonTarget);
         }
     }
+    return batch;
 }
 
-ApiResultType CsvChangeGenerator::fetchApiData() {
-    failedCsvApiRows_.clear();
-    std::size_t totalRows = csvData_.rows.size();
-    if (totalRows <= 1) { return ApiResultType{}; }
-
-    std::size_t threadCount = pool_.getAvailableThreadCount();
-    std::size_t dataRows = totalRows - 1; // exclede header
-
-    threadCount = std::max(std::size_t(1), std::min(threadCount, dataRows / 10));
-
-    std::size_t baseChunkSize = dataRows / threadCount;
-    std::size_t remainder = dataRows % threadCount;
-    std::size_t chunkStart = 1; // exclude header
-    std::size_t resultStart = 0;
-
-    ApiResultType results;
-    std::vector<std::future<void>> futures;
-    results.resize(dataRows);
-
-    for (std::size_t i = 0; i < threadCount; ++i) {
-        std::size_t currentChunkSize = baseChunkSize + (i < remainder ? 1 : 0);
-        std::span<std::vector<std::string>> chunk = std::span(csvData_.rows).subspan(chunkStart, currentChunkSize);
-        std::span<std::unordered_map<std::string, Change::colValMap>> resultChunk =
-            std::span(results).subspan(resultStart, currentChunkSize);
-        futures.push_back(pool_.submit(&CsvChangeGenerator::fetchChunk, this, chunk, resultChunk, chunkStart));
-        chunkStart += currentChunkSize;
-        resultStart += currentChunkSize;
-    }
-
-    for (auto& f : futures) {
-        f.get();
-    }
-    config_.saveApiArchive();
-    return results;
-}
-
-void CsvChangeGenerator::applyMappingToRow(const std::vector<std::string>& row,
-                                           ChangeConvertedMapping& mapped,
-                                           std::unordered_map<std::string, Change::colValMap>& apiData) {
-    std::unordered_set<std::size_t> visited;
-    for (std::size_t j = 0; j < mapped.columnIndexes.size(); j++) {
-        const std::size_t mappedColumnIndex = mapped.columnIndexes[j];
-        if (visited.contains(mappedColumnIndex)) { continue; }
-        visited.emplace(mappedColumnIndex);
-        const TargetData& mappedHeaders = mapped.preciseHeaders.at(mappedColumnIndex);
-        for (const PreciseMapLocationCombined& preciseHeader : mappedHeaders.dbHeaders) {
-            Change::colValMap& tableCells = mapped.cells.at(preciseHeader.locations.outerIdentifier).cells;
-            switch (preciseHeader.source) {
-            case SourceType::CSV:
-                tableCells.emplace(preciseHeader.locations.innerIdentifier, row.at(mappedColumnIndex));
-                break;
-            case SourceType::API:
-                tableCells.emplace(preciseHeader.locations.innerIdentifier,
-                                   apiData.at(preciseHeader.locations.outerIdentifier).at(preciseHeader.locations.innerIdentifier));
-                break;
-            default:
-                break;
-            }
+void CsvChangeGenerator::applyPlan(const MappingPlan& plan,
+                                   std::span<const std::string> row,
+                                   std::span<const std::string> apiValues,
+                                   std::size_t placeholder,
+                                   std::vector<TableCells>& rowCells) const {
+    rowCells.resize(plan.tables.size());
+    for (std::size_t t = 0; t < plan.tables.size(); ++t) {
+        const MappingPlan::Table& table = plan.tables[t];
+        TableCells& tableCells = rowCells[t];
+        tableCells.table = table.name;
+        tableCells.cells.clear(); // nothing of the previous row may leak into this one
+        for (const MappingPlan::Cell& cell : table.cells) {
+            tableCells.cells.emplace(cell.column, cell.source == SourceType::API ? apiValues[cell.index] : row[cell.index]);
         }
-    }
-}
-
-void CsvChangeGenerator::fillInAdditional(ChangeConvertedMapping& mapped) {
-    // Fill in missing
-    for (const auto& [_, preciseHeaders] : mapped.preciseHeaders) {
-        std::unordered_set<std::string> visitedTables;
-        for (const PreciseMapLocationCombined& preciseHeader : preciseHeaders.dbHeaders) {
-            if (visitedTables.contains(preciseHeader.locations.outerIdentifier)) { continue; }
-            visitedTables.insert(preciseHeader.locations.outerIdentifier);
-            for (const auto& header : dbData_->headers.at(preciseHeader.locations.outerIdentifier).data) {
-                if (mapped.cells[preciseHeader.locations.outerIdentifier].cells.contains(header.name) || header.nullable ||
-                    header.type == DB::HeaderTypes::PRIMARY_KEY) {
-                    continue;
-                }
-                mapped.cells[preciseHeader.locations.outerIdentifier].cells.emplace(header.name, std::format("TODO{}", missingParam_++));
-            }
+        for (const ColumnName& column : table.required) {
+            tableCells.cells.emplace(column, std::format("TODO{}", placeholder++));
         }
     }
 }
 
-void CsvChangeGenerator::sortMappedCells(ChangeConvertedMapping& mapped) {
-    mapped.orderedCells.clear();
-    mapped.orderedCells.reserve(mapped.cells.size());
-
-    for (auto& [tableName, tableCells] : mapped.cells) {
-        mapped.orderedCells.push_back(&tableCells);
+PreparedChange CsvChangeGenerator::prepareCells(TableCells& cells, const IndexPKeyPair& found, const DbSnapshot& db) const {
+    if (found.index == INVALID_ID) {
+        return changeTracker_.prepareChange(db, Change{std::move(cells.cells), ChangeType::INSERT_ROW, db.getTable(cells.table)});
     }
-
-    std::sort(mapped.orderedCells.begin(), mapped.orderedCells.end(), [&](const TableCells* a, const TableCells* b) {
-        return dbData_->headers.at(a->table).maxDepth < dbData_->headers.at(b->table).maxDepth;
-    });
+    db.updateChangeQuantity(cells.table, cells.cells, found.index, operation_);
+    Change change{std::move(cells.cells), ChangeType::UPDATE_CELLS, db.getTable(cells.table)};
+    // the new quantity is based on the snapshot, it must not overwrite one that changed since
+    db.captureExpectedCells(change, found.index);
+    return changeTracker_.prepareChange(db, std::move(change), static_cast<uint32_t>(found.pkey));
 }
 
-void CsvChangeGenerator::addChangesFromMapping(ChangeConvertedMapping& mapped) {
+PreparedSequence CsvChangeGenerator::prepareRow(std::vector<TableCells>& rowCells, const DbSnapshot& db) const {
     // This assumes that all changes caused by this row are children of the deepest mapping (the one which has the highest
     // db-relation-depth) This is incorrect in the general case, but a correct simplification in the use case here for example
     // part has manufacturer, therefore, if part exists, manufacturer doesnt need to be added
-    if (mapped.orderedCells.empty()) { return; }
-    TableCells* deepestCell = mapped.orderedCells.back();
-    if (processCell(deepestCell, true)) { return; }
+    PreparedSequence sequence;
+    if (rowCells.empty()) { return sequence; }
+    std::span<TableCells> tables{rowCells};
+
+    const IndexPKeyPair deepest = db.findIndexAndPKeyOfExisting(tables.back().table, tables.back().cells);
+    if (deepest.index != INVALID_ID) {
+        if (!db.hasQuantityColumn(tables.back().table)) { return sequence; }
+        sequence.push_back(prepareCells(tables.back(), deepest, db));
+        sequence.back().probe = true;
+        // only a duplicate of a pending change lets an invalid update count as added, else the row is done
+        if (sequence.back().valid) { return sequence; }
+        // otherwise the other tables follow, the deepest one would only fail again
+        tables = tables.first(tables.size() - 1);
+    }
 
-    for (TableCells* cells : mapped.orderedCells) {
-        if (!processCell(cells)) { break; }
+    for (TableCells& cells : tables) {
+        const IndexPKeyPair found = db.findIndexAndPKeyOfExisting(cells.table, cells.cells);
+        if (found.index != INVALID_ID && !db.hasQuantityColumn(cells.table)) { continue; }
+        sequence.push_back(prepareCells(cells, found, db));
     }
+    return sequence;
 }
 
-bool CsvChangeGenerator::processCell(TableCells* cells, bool onlyAddIfFound) {
-    // returns wether to continue
-    if (!cells) { return true; }
-    ChangeType type = ChangeType::INSERT_ROW;
-    IndexPKeyPair foundIndexes = dbService_.findIndexAndPKeyOfExisting(cells->table, cells->cells);
-    bool found = false;
-    if (foundIndexes.index != INVALID_ID) {
-        if (dbService_.hasQuantityColumn(cells->table)) {
-            dbService_.updateChangeQuantity(cells->table, cells->cells, foundIndexes.index, operation_);
-            found = true;
-            type = ChangeType::UPDATE_CELLS;
-        } else {
-            return true;
-        }
-    };
+std::vector<PreparedSequence> CsvChangeGenerator::prepareRows(
+    const CsvBatch& batch, const MappingPlan& plan, const DbSnapshot& db, std::size_t start, std::size_t end) const {
+    TraceSpan span{logger_, TraceEvent::IMPORT_PREPARE, end - start};
+    const std::size_t apiSlots = indirectApiMappings_.size();
+    std::vector<PreparedSequence> sequences(end - start);
+    std::vector<TableCells> rowCells;
+    for (std::size_t j = start; j < end; ++j) {
+#ifdef EXCLUDE_API_FAILS
+        if (batch.apiFailed[j]) { continue; } // written back by mergeBatch
+#endif
+        const std::size_t placeholder = plan.firstPlaceholder + (batch.firstRow + j - 1) * plan.placeholders;
+        const std::span<const std::string> apiValues = std::span<const std::string>(batch.apiValues).subspan(j * apiSlots, apiSlots);
+        applyPlan(plan, batch.rows[j], apiValues, placeholder, rowCells);
+        sequences[j - start] = prepareRow(rowCells, db);
+    }
+    return sequences;
+}
 
-    if (!found && onlyAddIfFound) { return false; }
-    Change change = Change{cells->cells, type, dbService_.getTable(cells->table)};
+Task<CsvBatch> CsvChangeGenerator::prepareBatch(CsvBatch batch, const MappingPlan& plan, const DbSnapshot& db) {
+    batch = co_await pool_.spawn(TaskLane::IO, TaskPriority::NORMAL, &CsvChangeGenerator::enrichBatch, this, std::move(batch));
 
-    ChangeAddResult result = changeTracker_.addChange(change, foundIndexes.pkey);
-    if (!ChangeTracker::gotAdded(result)) {
-        AutoGenInfo::changeAdded(change.getKey(), false);
-        logger_.pushLog(Log{std::format("ERROR: Adding change from mapping failed.")});
-        return false;
+    // rows only read the snapshot here, so they are prepared side by side and merged by the pipeline
+    std::vector<Task<std::vector<PreparedSequence>>> chunks;
+    for (std::size_t start = 0; start < batch.rows.size(); start += PREPARE_CHUNK_ROWS) {
+        const std::size_t end = std::min(batch.rows.size(), start + PREPARE_CHUNK_ROWS);
+        chunks.push_back(pool_.spawn(TaskLane::CPU, TaskPriority::NORMAL, [this, &batch, &plan, &db, start, end] {
+            return prepareRows(batch, plan, db, start, end);
+        }));
     }
 
-    AutoGenInfo::changeAdded(change.getKey(), true);
-    cells->cells.clear();
-    return true;
+    // batch stays in this frame until every chunk is done
+    std::vector<std::vector<PreparedSequence>> prepared = co_await pool_.whenAll(std::move(chunks));
+    batch.prepared.reserve(batch.rows.size());
+    for (std::vector<PreparedSequence>& chunk : prepared) {
+        std::move(chunk.begin(), chunk.end(), std::back_inserter(batch.prepared));
+    }
+    co_return batch;
 }
 
-void CsvChangeGenerator::executeCsv() {
-    std::size_t i = 0;
-    ChangeConvertedMapping mapped = convertMapping();
+void CsvChangeGenerator::mergeBatch(CsvBatch& batch, const DbSnapshot& db) {
+    METRIC_TIMER("csv.mergeBatch");
+#ifdef EXCLUDE_API_FAILS
+    for (std::size_t j = 0; j < batch.rows.size(); ++j) {
+        if (batch.apiFailed[j]) { failedCsvApiRows_.push_back(batch.rows[j]); }
+    }
+#endif
+    for (const auto& [key, result] : changeTracker_.addPrepared(batch.prepared, db)) {
+        const bool added = ChangeTracker::gotAdded(result);
+        AutoGenInfo::changeAdded(key, added);
+        if (!added) { logger_.pushLog(Log{std::format("ERROR: Adding change from mapping failed.")}); }
+    }
+    rowCount_ += batch.rows.size();
+}
 
-    std::vector<Change> changes;
-    ApiResultType results = fetchApiData();
-    for (const auto& row : csvData_.rows) {
-        if (i == 0) {
-            i++;
-            continue;
+Task<bool> CsvChangeGenerator::runPipeline(CsvBatchSource& source) {
+    TraceSpan span{logger_, TraceEvent::IMPORT_EXECUTE};
+    METRIC_TIMER("csv.executeCsv");
+    const auto started = std::chrono::steady_clock::now();
+    // one snapshot for the whole import, a refetch meanwhile must neither race the workers nor change what rows are checked against
+    const DbSnapshot db = dbService_.getSnapshot();
+    const MappingPlan plan = compileMappings(db);
+    failedCsvApiRows_.clear();
+    rowCount_ = 0;
+    // the whole import is undone at once
+    ChangeTracker::JournalGroup journalGroup{changeTracker_};
+
+    // Parsing runs one batch ahead, up to depth batches get their api data and prepared changes, merging takes them in csv order.
+    // Nothing blocks a worker and at most depth + 2 batches are alive, however large the file is.
+    const std::size_t depth = std::max(PIPELINE_MIN_DEPTH, pool_.getLaneStats(TaskLane::IO).workers);
+    Task<std::optional<CsvBatch>> parsing =
+        pool_.spawn(TaskLane::CPU, TaskPriority::LOW, &CsvBatchSource::next, &source, PIPELINE_BATCH_ROWS);
+    std::deque<Task<CsvBatch>> preparing;
+    bool parsed = false;
+    bool mergedAny = false;
+    while (true) {
+        // only wait for the parser if there is nothing else to do
+        while (!parsed && preparing.size() < depth && (preparing.empty() || parsing.isReady())) {
+            std::optional<CsvBatch> batch = co_await parsing;
+            if (!batch) {
+                parsed = true;
+                break;
+            }
+            preparing.push_back(prepareBatch(std::move(*batch), plan, db));
+            parsing = pool_.spawn(TaskLane::CPU, TaskPriority::LOW, &CsvBatchSource::next, &source, PIPELINE_BATCH_ROWS);
         }
-#ifdef EXCLUDE_API_FAILS
-        // no need to lock since all threads are done with it (fetchApiData)
-        if (failedCsvApiRows_.contains(i)) {
-            i++;
-            continue;
+        if (preparing.empty()) { break; }
+
+        // preparation ends on the cpu lane, so does the merge
+        CsvBatch batch = co_await preparing.front();
+        preparing.pop_front();
+        mergeBatch(batch, db);
+        if (!mergedAny) {
+            mergedAny = true;
+            METRIC_OBSERVE("csv.firstBatchMs",
+                           std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count());
         }
-#endif
-        applyMappingToRow(row, mapped, results.at(i - 1));
-        fillInAdditional(mapped);
-        sortMappedCells(mapped);
-        addChangesFromMapping(mapped);
-        i++;
     }
+    missingParam_ += rowCount_ * plan.placeholders;
+    span.setEndArg(rowCount_);
 
+    if (!indirectApiMappings_.empty()) { config_.saveApiArchive(); }
 #ifdef EXCLUDE_API_FAILS
     writeBackFailedRows();
 #endif
+    co_return !source.failed();
+}
+
+Task<void> CsvChangeGenerator::executeCsv() {
+    co_await pool_.schedule(TaskLane::CPU, TaskPriority::LOW);
+    CsvBatchSource source{logger_, csvData_.rows};
+    co_await runPipeline(source);
 }
 
 void CsvChangeGenerator::writeBackFailedRows() {
     if (failedCsvApiRows_.empty() || csvData_.rows.empty()) { return; }
     std::vector<std::vector<std::string>> rows;
+    rows.reserve(failedCsvApiRows_.size() + 1);
     rows.push_back(csvData_.rows.at(0)); // header
-
-    for (const std::size_t i : failedCsvApiRows_) {
-        rows.push_back(csvData_.rows.at(i));
-    }
+    rows.insert(rows.end(), std::make_move_iterator(failedCsvApiRows_.begin()), std::make_move_iterator(failedCsvApiRows_.end()));
+    failedCsvApiRows_.clear();
 
     std::filesystem::path failedPath = lastSuccessfulCsvPath_;
     failedPath.replace_filename(failedPath.stem().string() + "_FAILED" + failedPath.extension().string());
@@ -443,24 +544,21 @@ void CsvChangeGenerator::setData(std::shared_ptr<const CompleteDbData> newData)
 
 bool CsvChangeGenerator::dataValid(bool once) {
     if (!dbData_) { return false; }
-    if (!once) { return dataRead_; }
-    if (fRead_.valid()) {
-        if (fRead_.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
-            {
-                std::lock_guard<std::mutex> lock(mtxRead_);
-                dataRead_ = fRead_.get();
-            }
-            cvRead_.notify_all();
-            return dataRead_;
-        }
-    }
-    return false;
+    if (!once) { return dataRead_.load(std::memory_order_acquire); }
+    return readFresh_.exchange(false, std::memory_order_acq_rel) && dataRead_.load(std::memory_order_acquire);
 }
 
 void CsvChangeGenerator::read(std::filesystem::path csv) {
     AutoGenInfo::setCsvSource(csv);
     AutoGenInfo::setOperation(operation_);
-    fRead_ = pool_.submit(&CsvChangeGenerator::run, this, csv);
+    run(csv).then(TaskLane::CPU, TaskPriority::HIGH, [this](bool success) {
+        {
+            std::lock_guard<std::mutex> lock(mtxRead_);
+            dataRead_.store(success, std::memory_order_release);
+            readFresh_.store(true, std::memory_order_release);
+        }
+        cvRead_.notify_all();
+    });
 }
 
 const std::vector<std::string>& CsvChangeGenerator::getHeader() {
@@ -476,11 +574,16 @@ const std::vector<std::string>& CsvChangeGenerator::getFirstRow() {
 }
 
 void CsvChangeGenerator::setMappingsToDb(const std::vector<MappingNumber> mappings) {
+    storeMappings(std::vector<SerializableMapping>(mappings.begin(), mappings.end()));
+    reqExecuteCsv();
+}
+
+void CsvChangeGenerator::storeMappings(const std::vector<SerializableMapping>& mappings) {
     std::vector<MappingCsvToDb> mappingsFromCsv;
     std::vector<MappingCsvToDb> mappingsFromApi;
     mappingsFromCsv.reserve(mappings.size());
     mappingsFromApi.reserve(mappings.size());
-    for (const MappingNumber& mapping : mappings) {
+    for (const SerializableMapping& mapping : mappings) {
         if (auto* mappingToDb = std::get_if<MappingCsvToDb>(&mapping.usableData)) {
             switch (mapping.sourceType) {
             case SourceType::API:
@@ -507,9 +610,29 @@ void CsvChangeGenerator::setMappingsToDb(const std::vector<MappingNumber> mappin
     }
     directMappings_ = std::move(mappingsFromCsv);
     indirectApiMappings_ = std::move(mappingsFromApi);
-    reqExecuteCsv();
 }
 
 void CsvChangeGenerator::reqExecuteCsv() {
-    fExecMappings_ = pool_.submit(&CsvChangeGenerator::executeCsv, this);
+    execMappings_ = executeCsv();
+}
+
+Task<bool> CsvChangeGenerator::importCsv(std::filesystem::path csv, std::vector<SerializableMapping> mappings) {
+    AutoGenInfo::setCsvSource(csv);
+    AutoGenInfo::setOperation(operation_);
+    co_await pool_.schedule(TaskLane::CPU, TaskPriority::NORMAL);
+    if (!dbData_) {
+        logger_.pushLog(Log{"ERROR: Importing csv failed: No database data set."});
+        co_return false;
+    }
+    // streamed instead of read up front, the header is all that stays around
+    CsvBatchSource source{logger_};
+    if (!source.open(csv)) { co_return false; }
+    csvData_ = CSV::Data{{source.getHeader()}, {}};
+    lastSuccessfulCsvPath_ = csv;
+    storeMappings(mappings);
+    co_return co_await runPipeline(source);
+}
+
+std::size_t CsvChangeGenerator::getDataRowCount() {
+    return rowCount_;
 }
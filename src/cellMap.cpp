@@ -0,0 +1,133 @@
+#include "cellMap.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace {
+struct NameHash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+};
+
+const std::string EMPTY_NAME;
+} // namespace
+
+const std::string* ColumnName::intern(std::string_view name) {
+    // a node set, so interned strings never move
+    static std::unordered_set<std::string, NameHash, std::equal_to<>> names;
+    static std::shared_mutex mtx;
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+        const auto it = names.find(name);
+        if (it != names.end()) { return &*it; }
+    }
+    std::unique_lock<std::shared_mutex> lock(mtx);
+    return &*names.emplace(name).first;
+}
+
+ColumnName::ColumnName() : name_(&EMPTY_NAME) {}
+
+ColumnName::ColumnName(std::string_view name) : name_(intern(name)) {}
+
+CellMap::CellMap(CellMap&& other) noexcept
+    : inline_(std::move(other.inline_)), spilled_(std::move(other.spilled_)), size_(std::exchange(other.size_, 0)) {
+    other.spilled_.clear();
+}
+
+CellMap& CellMap::operator=(CellMap&& other) noexcept {
+    inline_ = std::move(other.inline_);
+    spilled_ = std::move(other.spilled_);
+    size_ = std::exchange(other.size_, 0);
+    other.spilled_.clear();
+    return *this;
+}
+
+CellMap::CellMap(std::initializer_list<std::pair<std::string_view, std::string>> cells) {
+    for (const auto& [name, value] : cells) {
+        try_emplace(name, value);
+    }
+}
+
+CellMap::Cell* CellMap::lowerBound(std::string_view name) {
+    return std::lower_bound(data(), data() + size_, name, [](const Cell& cell, std::string_view n) { return cell.first.str() < n; });
+}
+
+CellMap::Cell* CellMap::insertAt(Cell* position, ColumnName column, std::string value) {
+    const std::size_t index = static_cast<std::size_t>(position - data());
+    if (spilled_.empty() && size_ == INLINE_CELLS) {
+        spilled_.reserve(2 * INLINE_CELLS);
+        std::move(inline_.begin(), inline_.end(), std::back_inserter(spilled_));
+    }
+    if (!spilled_.empty()) {
+        const auto it = spilled_.insert(spilled_.begin() + static_cast<std::ptrdiff_t>(index), Cell{column, std::move(value)});
+        ++size_;
+        return &*it;
+    }
+    Cell* cells = inline_.data();
+    std::move_backward(cells + index, cells + size_, cells + size_ + 1);
+    cells[index] = Cell{column, std::move(value)};
+    ++size_;
+    return cells + index;
+}
+
+CellMap::Cell* CellMap::find(std::string_view name) {
+    Cell* cells = data();
+    for (std::size_t i = 0; i < size_; ++i) {
+        if (cells[i].first == name) { return cells + i; }
+    }
+    return cells + size_;
+}
+
+const CellMap::Cell* CellMap::find(std::string_view name) const {
+    return const_cast<CellMap*>(this)->find(name);
+}
+
+std::string& CellMap::at(std::string_view name) {
+    Cell* cell = find(name);
+    if (cell == data() + size_) { throw std::out_of_range("CellMap::at"); }
+    return cell->second;
+}
+
+const std::string& CellMap::at(std::string_view name) const {
+    return const_cast<CellMap*>(this)->at(name);
+}
+
+std::pair<CellMap::Cell*, bool> CellMap::try_emplace(ColumnName column, std::string value) {
+    Cell* position = lowerBound(column.str());
+    if (position != data() + size_ && position->first == column) { return {position, false}; }
+    return {insertAt(position, column, std::move(value)), true};
+}
+
+void CellMap::insertOrAssign(ColumnName column, std::string value) {
+    Cell* position = lowerBound(column.str());
+    if (position != data() + size_ && position->first == column) {
+        position->second = std::move(value);
+        return;
+    }
+    insertAt(position, column, std::move(value));
+}
+
+bool CellMap::erase(std::string_view name) {
+    Cell* cell = find(name);
+    if (cell == data() + size_) { return false; }
+    if (!spilled_.empty()) {
+        spilled_.erase(spilled_.begin() + (cell - spilled_.data()));
+    } else {
+        std::move(cell + 1, inline_.data() + size_, cell);
+        inline_[size_ - 1] = Cell{};
+    }
+    --size_;
+    return true;
+}
+
+void CellMap::clear() {
+    for (std::size_t i = 0; i < std::min(size_, INLINE_CELLS); ++i) {
+        inline_[i] = Cell{};
+    }
+    spilled_.clear();
+    size_ = 0;
+}
@@ -1,7 +1,10 @@
 #include "change.hpp"
 
+#include <algorithm>
+#include <stdexcept>
+
 Change::Change(Change::colValMap cCells, ChangeType cType, ImTable cTable, std::optional<std::size_t> cRowId)
-    : changeKey_(nextId_++), changedCells_(cCells), type_(cType), tableData_(cTable), rowId_(cRowId) {}
+    : changeKey_(nextId_++), changedCells_(std::move(cCells)), type_(cType), tableData_(cTable), rowId_(cRowId) {}
 
 void Change::setLogger(Logger& l) {
     logger_ = &l;
@@ -27,33 +30,70 @@ uint32_t Change::getRowId() const {
     return rowId_.value();
 }
 
-Change::colValMap Change::getCells() const {
+const Change::colValMap& Change::getCells() const {
     return changedCells_;
 }
 
-std::string Change::getCell(const std::string& header) const {
-    if (!changedCells_.contains(header)) { return std::string(); }
-    return changedCells_.at(header);
+const std::string& Change::getCell(const std::string& header) const {
+    static const std::string empty;
+    const CellMap::Cell* cell = changedCells_.find(header);
+    return cell != changedCells_.end() ? cell->second : empty;
+}
+
+const Change::expCellMap& Change::getExpectedCells() const {
+    return expectedCells_;
+}
+
+bool Change::hasExpectedCells() const {
+    return !expectedCells_.empty();
+}
+
+void Change::setExpectedCells(expCellMap cells) {
+    expectedCells_ = std::move(cells);
+}
+
+void Change::addExpectedCells(const expCellMap& cells) {
+    for (const auto& [col, cell] : cells) {
+        expectedCells_.try_emplace(col, cell);
+    }
 }
 
 Change& Change::operator^(const Change& other) {
     if (this != &other) {
         for (auto const& [col, val] : other.changedCells_) {
-            this->changedCells_[col] = val;
-            logger_->pushLog(Log{std::format("            change now has column: {} with cell value: {}", col, val)});
+            this->changedCells_.insertOrAssign(col, val);
+            if (logger_) { logger_->log<LogLevel::TRACE>("            change now has column: {} with cell value: {}", col.str(), val); }
         }
     }
-    if (logger_) { logger_->pushLog(Log{std::format("^^ operator")}); }
+    if (logger_) { logger_->log<LogLevel::TRACE>("^^ operator"); }
 
     return *this;
 }
 
+std::string Change::expectedCondition(std::vector<std::string>& params) const {
+    std::string condition;
+    for (const auto& [col, cell] : expectedCells_) {
+        if (!cell.value) {
+            condition += std::format(" AND {} IS NULL", col);
+            continue;
+        }
+        params.push_back(*cell.value);
+        // the value is the column's text output, read back in its type it compares like the column does
+        if (cell.type.empty()) {
+            condition += std::format(" AND {}::text IS NOT DISTINCT FROM ${}", col, params.size());
+        } else {
+            condition += std::format(" AND {} IS NOT DISTINCT FROM ${}::{}", col, params.size(), cell.type);
+        }
+    }
+    return condition;
+}
+
 SqlQuery Change::toSQLaction(SqlAction action) const {
     SqlQuery result;
     switch (type_) {
     case ChangeType::DELETE_ROW:
-        result.query = std::format("DELETE FROM {} WHERE id = $1", tableData_.name);
         result.params.push_back(std::to_string(rowId_.value()));
+        result.query = std::format("DELETE FROM {} WHERE id = $1{}", tableData_.name, expectedCondition(result.params));
         break;
 
     case ChangeType::INSERT_ROW: {
@@ -62,8 +102,14 @@ SqlQuery Change::toSQLaction(SqlAction action) const {
         bool first = true;
         int paramIndex = 1;
 
+        if (reservedRowId_) {
+            columnNames = "id";
+            placeholders = std::format("${}", paramIndex++);
+            result.params.push_back(std::to_string(rowId_.value()));
+            first = false;
+        }
         for (const auto& [col, val] : changedCells_) {
-            if (col.empty() || val.empty()) continue;
+            if (col.str().empty() || val.empty()) continue;
             if (!first) {
                 columnNames += ", ";
                 placeholders += ", ";
@@ -75,7 +121,8 @@ SqlQuery Change::toSQLaction(SqlAction action) const {
             result.params.push_back(val);
         }
 
-        result.query = std::format("INSERT INTO {} ({}) VALUES ({});", tableData_.name, columnNames, placeholders);
+        // the id the database ended up using, it only differs from the row id when that was not reserved
+        result.query = std::format("INSERT INTO {} ({}) VALUES ({}) RETURNING id;", tableData_.name, columnNames, placeholders);
         break;
     }
 
@@ -86,12 +133,13 @@ SqlQuery Change::toSQLaction(SqlAction action) const {
         for (const auto& [col, val] : changedCells_) {
             if (!first) pairs += ", ";
             first = false;
-            pairs += std::format("{} = ${}", col, paramIndex++);
+            pairs += std::format("{} = ${}", col.str(), paramIndex++);
             result.params.push_back(val);
         }
 
-        result.query = std::format("UPDATE {} SET {} WHERE id = ${};", tableData_.name, pairs, paramIndex);
         result.params.push_back(std::to_string(rowId_.value()));
+        const std::string condition = expectedCondition(result.params);
+        result.query = std::format("UPDATE {} SET {} WHERE id = ${}{};", tableData_.name, pairs, paramIndex, condition);
         break;
     }
     default:
@@ -117,6 +165,15 @@ void Change::setRowId(uint32_t aRowId) {
     rowId_ = aRowId;
 }
 
+void Change::setReservedRowId(uint32_t aRowId) {
+    rowId_ = aRowId;
+    reservedRowId_ = true;
+}
+
+bool Change::hasReservedRowId() const {
+    return reservedRowId_;
+}
+
 bool Change::hasParent() const {
     return parentKeys_.size() != 0;
 }
@@ -174,7 +231,7 @@ std::string Change::getCellSummary(const uint8_t len) const {
     std::string concat = selected_ ? "\n" : ",";
     for (const auto& [col, val] : changedCells_) {
         if (!summary.empty()) { summary += concat; }
-        summary += std::format("{}={}", col, val);
+        summary += std::format("{}={}", col.str(), val);
         if (summary.size() >= len && !selected_) {
             summary.resize(len - 3);
             summary += "...";
@@ -183,13 +240,36 @@ std::string Change::getCellSummary(const uint8_t len) const {
     return summary;
 }
 
+const uiTableChanges* uiChangeInfo::getTable(const std::string& table) const {
+    const auto it = tables.find(table);
+    return it == tables.end() ? nullptr : it->second.get();
+}
+
+const Change& uiChangeInfo::getChange(std::size_t key) const {
+    // few tables, searching each beats keeping a key index per version
+    for (const auto& [name, table] : tables) {
+        const auto it = table->changes.find(key);
+        if (it != table->changes.end()) { return it->second; }
+    }
+    throw std::out_of_range(std::format("Change {} is not part of the snapshot.", key));
+}
+
+std::size_t uiChangeInfo::changeCount() const {
+    std::size_t count = 0;
+    for (const auto& [name, table] : tables) {
+        count += table->changes.size();
+    }
+    return count;
+}
+
 std::unique_ptr<Change>
-ChangeHelpers::getChangeOfRow(const std::shared_ptr<uiChangeInfo>& uiChanges, const std::string& table, const std::size_t id) {
-    if (!uiChanges->idMappedChanges.contains(table)) { return nullptr; }
+ChangeHelpers::getChangeOfRow(const std::shared_ptr<const uiChangeInfo>& uiChanges, const std::string& table, const std::size_t id) {
+    const uiTableChanges* tableChanges = uiChanges->getTable(table);
+    if (!tableChanges) { return nullptr; }
     if (id == INVALID_ID) { return nullptr; }
-    if (uiChanges->idMappedChanges.at(table).contains(id)) {
-        const std::size_t changeKey = uiChanges->idMappedChanges.at(table).at(id);
-        return std::make_unique<Change>(uiChanges->changes.at(changeKey));
+    if (tableChanges->idMappedChanges.contains(id)) {
+        const std::size_t changeKey = tableChanges->idMappedChanges.at(id);
+        return std::make_unique<Change>(tableChanges->changes.at(changeKey));
     }
     return nullptr;
 }
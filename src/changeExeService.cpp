@@ -1,66 +1,65 @@
 #include "changeExeService.hpp"
 #include "autoGenInfo.hpp"
 
-void ChangeExeService::collectChanges(std::size_t key, std::unordered_set<std::size_t>& visited, std::vector<Change>& order) {
-    if (visited.contains(key)) { return; }
-    visited.insert(key);
-    if (changeTracker_.hasChild(key)) {
-        for (std::size_t child : changeTracker_.getChildren(key)) {
-            collectChanges(child, visited, order);
-        }
-    }
-    auto change = changeTracker_.getChange(key);
-    if (change) { order.push_back(*change); }
-}
-
-std::vector<Change> ChangeExeService::collectDescendants(const std::vector<std::size_t>& roots) {
-    std::unordered_set<std::size_t> visited;
-    std::vector<Change> order;
+ChangeExeService::ChangeExeService(DbService& cDbService, ChangeTracker& cChangeTracker, Logger& cLogger)
+    : dbService_(cDbService), changeTracker_(cChangeTracker), logger_(cLogger) {}
 
-    for (std::size_t root : roots) {
-        collectChanges(root, visited, order);
+Task<void> ChangeExeService::startApplication(std::vector<Change> changes, SqlAction action) {
+    // execution -> removal of the executed changes -> archive, without waiting for a frame in between
+    TraceSpan span{logger_, TraceEvent::CHANGE_APPLY, changes.size()};
+    AppliedChanges applied;
+    try {
+        applied = co_await dbService_.requestChangeApplication(std::move(changes), action);
+        changeTracker_.removeChanges(applied.keys);
+        changeTracker_.clearJournal();
+        changeTracker_.raiseMaxPKeys(applied.maxRowIds);
+        AutoGenInfo::finish(applied.keys);
+    } catch (std::exception const& e) {
+        // nobody reads the task, the ui only learns of the end through applicationDone_
+        logger_.pushLog(Log{std::format("ERROR: Applying changes failed: {}", e.what())});
     }
-
-    return order;
+    {
+        std::lock_guard<std::mutex> lg(resultMtx_);
+        successfulChanges_ = std::move(applied.keys);
+        conflictingChanges_ = std::move(applied.conflicts);
+    }
+    applicationDone_.store(true, std::memory_order_release);
 }
 
-ChangeExeService::ChangeExeService(DbService& cDbService, ChangeTracker& cChangeTracker, Logger& cLogger)
-    : dbService_(cDbService), changeTracker_(cChangeTracker), logger_(cLogger) {}
-
 bool ChangeExeService::isChangeApplicationDone() {
-    if (fApplyChanges_.valid() && fApplyChanges_.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) { return true; }
-    return false;
+    return applicationDone_.load(std::memory_order_acquire);
 }
 
 Change::chHashV ChangeExeService::getSuccessfulChanges() {
-    Change::chHashV successfulChanges{};
-    if (isChangeApplicationDone()) {
-        successfulChanges = fApplyChanges_.get();
-        changeTracker_.removeChanges(successfulChanges);
+    if (!applicationDone_.exchange(false, std::memory_order_acq_rel)) { return Change::chHashV{}; }
+    std::lock_guard<std::mutex> lg(resultMtx_);
+    return std::move(successfulChanges_);
+}
 
-        AutoGenInfo::finish(successfulChanges);
-    }
-    return successfulChanges;
+Change::chHashV ChangeExeService::getConflictingChanges() {
+    std::lock_guard<std::mutex> lg(resultMtx_);
+    return std::move(conflictingChanges_);
 }
 
-void ChangeExeService::requestChangeApplication(std::size_t changeKey, SqlAction action) {
+Task<void> ChangeExeService::requestChangeApplication(std::size_t changeKey, SqlAction action) {
     // reqests executiion for 1 changeKey (and its descendants)
     std::vector<std::size_t> keys = {changeKey};
-    requestChangeApplication(keys, action);
+    return requestChangeApplication(keys, action);
 }
 
-void ChangeExeService::requestChangeApplication(const std::vector<std::size_t> changeKeys, SqlAction action) {
+Task<void> ChangeExeService::requestChangeApplication(const std::vector<std::size_t> changeKeys, SqlAction action) {
     // requests execution for vector of changeKey
     changeTracker_.freeze();
-    std::vector<Change> allChanges = collectDescendants(changeKeys);
-    fApplyChanges_ = dbService_.requestChangeApplication(allChanges, action);
+    std::vector<Change> allChanges = changeTracker_.collectSubtrees(changeKeys);
     changeTracker_.unfreeze();
+    // the task starts eagerly and may finish on this thread, the removal in it must not wait for our own freeze
+    return startApplication(std::move(allChanges), action);
 }
 
-void ChangeExeService::requestChangeApplication(SqlAction action) {
+Task<void> ChangeExeService::requestChangeApplication(SqlAction action) {
     // request execution for all changes
     changeTracker_.freeze();
-    std::vector<Change> allChanges = collectDescendants(changeTracker_.getCalcRoots());
-    fApplyChanges_ = dbService_.requestChangeApplication(allChanges, action);
+    std::vector<Change> allChanges = changeTracker_.collectSubtrees(changeTracker_.getCalcRoots());
     changeTracker_.unfreeze();
+    return startApplication(std::move(allChanges), action);
 }
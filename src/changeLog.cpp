@@ -0,0 +1,398 @@
+#include "changeLog.hpp"
+#include "changeTracker.hpp"
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#ifdef _WIN32
+#include "windows.h"
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr std::string_view MAGIC = "INVCHLG2"; // the last character is the format version
+constexpr std::size_t FRAME_HEADER = 2 * sizeof(uint32_t);
+
+enum ChangeFlags : uint8_t { SELECTED = 1, LOCALLY_VALID = 2, VALID = 4, RESERVED_ROW_ID = 8, EXPECTED_CELLS = 16 };
+
+// crc32 (ieee) eight bytes at a time, CRC_TABLES[k] advances a byte through k more zero bytes
+constexpr std::array<std::array<uint32_t, 256>, 8> CRC_TABLES = [] {
+    std::array<std::array<uint32_t, 256>, 8> tables{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        tables[0][i] = crc;
+    }
+    for (std::size_t k = 1; k < tables.size(); ++k) {
+        for (uint32_t i = 0; i < 256; ++i) {
+            tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xFF];
+        }
+    }
+    return tables;
+}();
+
+uint32_t crc32(std::string_view data) {
+    const auto& t = CRC_TABLES;
+    uint32_t crc = 0xFFFFFFFFu;
+    std::size_t i = 0;
+    for (; i + 8 <= data.size(); i += 8) {
+        uint32_t low = 0;
+        uint32_t high = 0;
+        std::memcpy(&low, data.data() + i, sizeof(low));
+        std::memcpy(&high, data.data() + i + sizeof(low), sizeof(high));
+        low ^= crc;
+        crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^ t[3][high & 0xFF] ^
+              t[2][(high >> 8) & 0xFF] ^ t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+    }
+    for (; i < data.size(); ++i) {
+        crc = t[0][(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// host byte order, the file stays on the machine that wrote it
+template <typename T> void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void putString(std::string& out, std::string_view value) {
+    put(out, static_cast<uint32_t>(value.size()));
+    out.append(value);
+}
+
+void putCells(std::string& out, const Change::colValMap& cells) {
+    put(out, static_cast<uint32_t>(cells.size()));
+    for (const auto& [column, value] : cells) {
+        putString(out, column.str());
+        putString(out, value);
+    }
+}
+
+void putExpectedCells(std::string& out, const Change::expCellMap& cells) {
+    put(out, static_cast<uint32_t>(cells.size()));
+    for (const auto& [column, cell] : cells) {
+        putString(out, column);
+        putString(out, cell.type);
+        put(out, static_cast<uint8_t>(cell.value.has_value()));
+        if (cell.value) { putString(out, *cell.value); }
+    }
+}
+
+void putKeys(std::string& out, const std::vector<std::size_t>& keys) {
+    put(out, static_cast<uint32_t>(keys.size()));
+    for (const std::size_t key : keys) {
+        put(out, static_cast<uint64_t>(key));
+    }
+}
+
+std::string readFile(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) { return {}; }
+    std::string content(static_cast<std::size_t>(in.tellg()), '\0');
+    in.seekg(0);
+    in.read(content.data(), static_cast<std::streamsize>(content.size()));
+    return content;
+}
+
+// Waits until the file, or the entries of the directory, reached the disk. A flushed stream only reached the os.
+bool syncToDisk(const std::filesystem::path& path) {
+#ifdef _WIN32
+    // directory entries are journaled by ntfs itself and cannot be flushed
+    if (std::filesystem::is_directory(path)) { return true; }
+    HANDLE file =
+        CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) { return false; }
+    const bool synced = FlushFileBuffers(file);
+    CloseHandle(file);
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) { return false; }
+    const bool synced = fsync(fd) == 0;
+    ::close(fd);
+#endif
+    return synced;
+}
+} // namespace
+
+// Bounds checked reads, running past the end marks the frame as damaged instead of reading beyond it.
+class ChangeLog::Reader {
+  private:
+    std::string_view data_;
+    bool ok_ = true;
+    std::vector<ColumnName> columns_;
+
+  public:
+    explicit Reader(std::string_view cData) : data_(cData) {}
+
+    void reset(std::string_view data) {
+        data_ = data;
+        ok_ = true;
+    }
+
+    bool ok() const { return ok_; }
+    bool done() const { return data_.empty(); }
+
+    template <typename T> T get() {
+        T value{};
+        if (data_.size() < sizeof(T)) {
+            ok_ = false;
+            return value;
+        }
+        std::memcpy(&value, data_.data(), sizeof(T));
+        data_.remove_prefix(sizeof(T));
+        return value;
+    }
+
+    std::string_view getString() {
+        const uint32_t size = get<uint32_t>();
+        if (data_.size() < size) {
+            ok_ = false;
+            return {};
+        }
+        const std::string_view value = data_.substr(0, size);
+        data_.remove_prefix(size);
+        return value;
+    }
+
+    // logged changes share a handful of columns, only the first sight of one is interned
+    ColumnName getColumn() {
+        const std::string_view name = getString();
+        const auto it = std::ranges::find(columns_, name, &ColumnName::str);
+        if (it != columns_.end()) { return *it; }
+        return columns_.emplace_back(name);
+    }
+
+    Change::colValMap getCells() {
+        Change::colValMap cells;
+        const uint32_t count = get<uint32_t>();
+        for (uint32_t i = 0; i < count && ok_; ++i) {
+            const ColumnName column = getColumn();
+            cells.insertOrAssign(column, std::string{getString()});
+        }
+        return cells;
+    }
+
+    Change::expCellMap getExpectedCells() {
+        Change::expCellMap cells;
+        const uint32_t count = get<uint32_t>();
+        for (uint32_t i = 0; i < count && ok_; ++i) {
+            ExpectedCell& cell = cells[std::string{getString()}];
+            cell.type = getString();
+            if (get<uint8_t>() != 0) { cell.value = std::string{getString()}; }
+        }
+        return cells;
+    }
+
+    std::vector<std::size_t> getKeys() {
+        const uint32_t count = get<uint32_t>();
+        if (data_.size() / sizeof(uint64_t) < count) {
+            ok_ = false;
+            return {};
+        }
+        std::vector<std::size_t> keys(count);
+        for (std::size_t& key : keys) {
+            key = static_cast<std::size_t>(get<uint64_t>());
+        }
+        return keys;
+    }
+};
+
+void ChangeLog::encode(std::string& out, std::size_t key, const Change* change) {
+    put(out, static_cast<uint64_t>(key));
+    put(out, static_cast<uint8_t>(change != nullptr));
+    if (!change) { return; }
+    putString(out, change->getTable());
+    put(out, static_cast<uint8_t>(change->getType()));
+    put(out, static_cast<uint8_t>(change->hasRowId()));
+    put(out, change->hasRowId() ? change->getRowId() : uint32_t{0});
+    putCells(out, change->getCells());
+    putKeys(out, change->getParents());
+    putKeys(out, change->getChildren());
+    put(out, static_cast<uint8_t>((change->isSelected() ? SELECTED : 0) | (change->isLocallyValid() ? LOCALLY_VALID : 0) |
+                                  (change->isValid() ? VALID : 0) | (change->hasReservedRowId() ? RESERVED_ROW_ID : 0) |
+                                  (change->hasExpectedCells() ? EXPECTED_CELLS : 0)));
+    // behind the flags, records written before there were expectations stay readable
+    if (change->hasExpectedCells()) { putExpectedCells(out, change->getExpectedCells()); }
+}
+
+std::optional<Change> ChangeLog::decode(Reader& reader, std::size_t key, std::vector<ImTable>& tables, const DbService& dbService) {
+    const std::string_view tableName = reader.getString();
+    auto table = std::ranges::find(tables, tableName, &ImTable::name);
+    if (table == tables.end()) { table = tables.insert(table, dbService.getTable(std::string{tableName})); }
+    const auto type = static_cast<ChangeType>(reader.get<uint8_t>());
+    const bool hasRowId = reader.get<uint8_t>() != 0;
+    const uint32_t rowId = reader.get<uint32_t>();
+    Change::colValMap cells = reader.getCells();
+    std::vector<std::size_t> parents = reader.getKeys();
+    std::vector<std::size_t> children = reader.getKeys();
+    const uint8_t flags = reader.get<uint8_t>();
+    Change::expCellMap expected = flags & EXPECTED_CELLS ? reader.getExpectedCells() : Change::expCellMap{};
+    if (!reader.ok()) { return std::nullopt; }
+
+    Change change{std::move(cells), type, *table, hasRowId ? std::optional<std::size_t>{rowId} : std::nullopt};
+    change.changeKey_ = key;
+    change.parentKeys_ = std::move(parents);
+    change.childrenKeys_ = std::move(children);
+    change.selected_ = flags & SELECTED;
+    change.locallyValid_ = flags & LOCALLY_VALID;
+    change.valid_ = flags & VALID;
+    change.reservedRowId_ = flags & RESERVED_ROW_ID;
+    change.expectedCells_ = std::move(expected);
+    // changes created from now on must not reuse the key
+    std::size_t next = Change::nextId_.load();
+    while (next <= key && !Change::nextId_.compare_exchange_weak(next, key + 1)) {}
+    return change;
+}
+
+bool ChangeLog::writeFrame(std::ofstream& out, const std::string& payload) {
+    std::string header;
+    put(header, static_cast<uint32_t>(payload.size()));
+    put(header, crc32(payload));
+    out.write(header.data(), static_cast<std::streamsize>(header.size()));
+    out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+    out.flush();
+    return out.good();
+}
+
+void ChangeLog::fail(const std::string& action) {
+    logger_.pushLog(Log{std::format("ERROR: Could not {} {}, pending changes are no longer saved.", action, path_.string())});
+    out_.close();
+}
+
+bool ChangeLog::isOpen() const {
+    return out_.is_open();
+}
+
+std::optional<std::vector<Change>> ChangeLog::load(const std::filesystem::path& path, const DbService& dbService) {
+    METRIC_TIMER("changeLog.load");
+    path_ = path;
+    const std::string content = readFile(path);
+    if (content.empty()) { return std::vector<Change>{}; }
+    if (!content.starts_with(MAGIC)) {
+        logger_.pushLog(
+            Log{std::format("ERROR: {} is no pending change log of this version, pending changes are not saved.", path.string())});
+        return std::nullopt;
+    }
+
+    // first sight of a key decides its place, erased ones leave an empty one behind
+    std::vector<std::optional<Change>> changes;
+    FlatHashMap<std::size_t, std::size_t> positions;
+    std::vector<std::pair<std::size_t, std::optional<Change>>> frame;
+    std::vector<ImTable> tables;
+    Reader reader{content};
+    std::size_t offset = MAGIC.size();
+    while (content.size() - offset >= FRAME_HEADER) {
+        uint32_t size = 0;
+        uint32_t crc = 0;
+        std::memcpy(&size, content.data() + offset, sizeof(size));
+        std::memcpy(&crc, content.data() + offset + sizeof(size), sizeof(crc));
+        if (content.size() - offset - FRAME_HEADER < size) { break; }
+        const std::string_view payload{content.data() + offset + FRAME_HEADER, size};
+        if (crc32(payload) != crc) { break; }
+
+        // a frame is one operation, it applies completely or not at all
+        reader.reset(payload);
+        frame.clear();
+        const uint32_t records = reader.get<uint32_t>();
+        for (uint32_t i = 0; i < records && reader.ok(); ++i) {
+            const std::size_t key = static_cast<std::size_t>(reader.get<uint64_t>());
+            const bool present = reader.get<uint8_t>() != 0;
+            frame.emplace_back(key, present ? decode(reader, key, tables, dbService) : std::nullopt);
+            if (present && !frame.back().second) { break; }
+        }
+        if (!reader.ok() || !reader.done() || frame.size() != records) { break; }
+        // the compacted frame in front holds nearly all changes
+        if (changes.size() + records > changes.capacity()) {
+            changes.reserve(std::max(2 * changes.capacity(), changes.size() + records));
+            positions.reserve(changes.capacity());
+        }
+        for (auto& [key, change] : frame) {
+            if (std::size_t* position = positions.find(key)) {
+                changes[*position] = std::move(change);
+            } else if (change) {
+                positions.insertOrAssign(key, changes.size());
+                changes.push_back(std::move(change));
+            }
+        }
+        records_ += records;
+        offset += FRAME_HEADER + size;
+    }
+    if (offset < content.size()) {
+        logger_.pushLog(Log{std::format("WARNING: The last {} bytes of {} are damaged, the operation they held is lost.",
+                                        content.size() - offset, path.string())});
+    }
+
+    std::vector<Change> result;
+    result.reserve(changes.size());
+    for (std::optional<Change>& change : changes) {
+        if (change) { result.push_back(std::move(*change)); }
+    }
+    return result;
+}
+
+void ChangeLog::append(std::span<const std::size_t> keys, const ChangeStore& store) {
+    if (!isOpen() || keys.empty()) { return; }
+    std::string payload;
+    put(payload, static_cast<uint32_t>(keys.size()));
+    for (const std::size_t key : keys) {
+        encode(payload, key, store.find(key));
+    }
+    if (!writeFrame(out_, payload)) {
+        fail("write to");
+        return;
+    }
+    records_ += keys.size();
+}
+
+bool ChangeLog::wantsCompaction(std::size_t pendingChanges) const {
+    return records_ > std::max(COMPACT_MIN_RECORDS, COMPACT_FACTOR * pendingChanges);
+}
+
+void ChangeLog::compact(const ChangeStore& store) {
+    METRIC_TIMER("changeLog.compact");
+    std::string payload;
+    put(payload, static_cast<uint32_t>(store.size()));
+    for (const Change& change : store) {
+        encode(payload, change.getKey(), &change);
+    }
+
+    out_.close();
+    std::filesystem::path temporary = path_;
+    temporary += ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(MAGIC.data(), static_cast<std::streamsize>(MAGIC.size()));
+        if (!writeFrame(out, payload)) {
+            fail("write to");
+            return;
+        }
+    }
+    // the rename may reach the disk before the data, a crash in between would leave an empty log behind
+    if (!syncToDisk(temporary)) {
+        fail("sync");
+        return;
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path_, error);
+    if (error) {
+        fail("replace");
+        return;
+    }
+    // until the directory is synced, a crash may bring back the uncompacted log
+    if (!syncToDisk(path_.has_parent_path() ? path_.parent_path() : std::filesystem::path{"."})) {
+        fail("sync the directory of");
+        return;
+    }
+    out_.open(path_, std::ios::binary | std::ios::app);
+    if (!out_) {
+        fail("open");
+        return;
+    }
+    records_ = store.size();
+}
@@ -1,10 +1,120 @@
 #include "changeTracker.hpp"
+#include "metrics.hpp"
+
+#include <algorithm>
 
 #undef WITH_DETAILED_LOG
 
+void ChangeStore::markDirty(const std::string& table) {
+    ++version_;
+    dirtyTables_.insert(table);
+}
+
+bool ChangeStore::contains(std::size_t key) const {
+    return handles_.contains(key);
+}
+
+const Change* ChangeStore::find(std::size_t key) const {
+    const SlotHandle* handle = handles_.find(key);
+    return handle ? changes_.get(*handle) : nullptr;
+}
+
+const Change& ChangeStore::at(std::size_t key) const {
+    return *changes_.get(handles_.at(key));
+}
+
+void ChangeStore::record(std::size_t key) {
+    if (tracking_ && !writtenKeys_.contains(key)) {
+        writtenKeys_.insertOrAssign(key, true);
+        written_.push_back(key);
+    }
+    if (!recording_ || recordedKeys_.contains(key)) { return; }
+    recordedKeys_.insertOrAssign(key, true);
+    const Change* change = find(key);
+    recorded_.emplace_back(key, change ? std::optional<Change>{*change} : std::nullopt);
+}
+
+Change& ChangeStore::edit(std::size_t key) {
+    record(key);
+    Change& change = *changes_.get(handles_.at(key));
+    markDirty(change.getTable());
+    return change;
+}
+
+void ChangeStore::insertOrAssign(Change change) {
+    record(change.getKey());
+    markDirty(change.getTable());
+    if (const SlotHandle* handle = handles_.find(change.getKey())) {
+        *changes_.get(*handle) = std::move(change);
+        return;
+    }
+    const std::size_t key = change.getKey();
+    handles_.insertOrAssign(key, changes_.insert(std::move(change)));
+}
+
+std::optional<Change> ChangeStore::take(std::size_t key) {
+    const SlotHandle* handle = handles_.find(key);
+    if (!handle) { return std::nullopt; }
+    record(key);
+    Change& change = *changes_.get(*handle);
+    markDirty(change.getTable());
+    std::optional<Change> taken{std::move(change)};
+    changes_.erase(*handle);
+    handles_.erase(key);
+    return taken;
+}
+
+bool ChangeStore::erase(std::size_t key) {
+    const SlotHandle* handle = handles_.find(key);
+    if (!handle) { return false; }
+    record(key);
+    markDirty(changes_.get(*handle)->getTable());
+    changes_.erase(*handle);
+    handles_.erase(key);
+    return true;
+}
+
+std::size_t ChangeStore::size() const {
+    return changes_.size();
+}
+
+void ChangeStore::reserve(std::size_t count) {
+    changes_.reserve(count);
+    handles_.reserve(count);
+}
+
+std::size_t ChangeStore::version() const {
+    return version_;
+}
+
+std::set<std::string> ChangeStore::takeDirtyTables() {
+    return std::exchange(dirtyTables_, {});
+}
+
+void ChangeStore::startRecording() {
+    recording_ = true;
+}
+
+std::vector<ChangeImage> ChangeStore::stopRecording() {
+    recording_ = false;
+    recordedKeys_.clear();
+    return std::exchange(recorded_, {});
+}
+
+void ChangeStore::trackWrites() {
+    tracking_ = true;
+}
+
+std::vector<std::size_t> ChangeStore::takeWritten() {
+    writtenKeys_.clear();
+    return std::exchange(written_, {});
+}
+
 void ChangeTracker::mergeCellChanges(Change& existingChange, const Change& newChange) {
-    logger_.pushLog(Log{std::format("        Merging cell changes {} and {}", existingChange.getKey(), newChange.getKey())});
+    logger_.log<LogLevel::DEBUG>("        Merging cell changes {} and {}", existingChange.getKey(), newChange.getKey());
     existingChange ^ newChange;
+    // the earliest expectation stands, a later one was read after this change was already pending
+    if (existingChange.getType() == ChangeType::UPDATE_CELLS) { existingChange.addExpectedCells(newChange.getExpectedCells()); }
 }
 
 void ChangeTracker::freeze() {
@@ -26,32 +136,31 @@ void ChangeTracker::waitIfFrozen() {
 }
 
 std::optional<Change> ChangeTracker::getChange(std::size_t key) {
-    std::lock_guard<std::mutex> lg(changes_.mtx);
+    std::shared_lock<std::shared_mutex> lg(changes_.mtx);
 
-    auto it = changes_.flatData.find(key);
-    if (it == changes_.flatData.end()) {
+    const Change* change = changes_.flatData.find(key);
+    if (!change) {
         logger_.pushLog(Log{std::format("ERROR: Change with key {} not found.", key)});
         return std::nullopt;
     }
 
-    return it->second;
+    return *change;
 }
 
 bool ChangeTracker::isConflicting(const Change& newChange) {
     if (!newChange.hasRowId() || newChange.getType() == ChangeType::INSERT_ROW) { return false; }
     const std::string& table = newChange.getTable();
     const uint32_t rowId = newChange.getRowId();
-    if (!changes_.pKeyMappedData.contains(table)) { return false; }
-    if (!changes_.pKeyMappedData.at(table).contains(rowId)) { return false; }
-    return true;
+    const auto keys = changes_.tableKeys.find(table);
+    return keys != changes_.tableKeys.end() && keys->second.pKeys.contains(rowId);
 }
 
-Change& ChangeTracker::manageConflictL(Change& newChange) {
+Change& ChangeTracker::manageConflictL(Change& newChange, const DbSnapshot& db) {
     logDetail(std::format("Managing conflict for change {}.", newChange.getKey()));
     if (!isConflicting(newChange)) { return newChange; }
     const std::string& table = newChange.getTable();
     const uint32_t rowId = newChange.getRowId();
-    Change& existingChange = changes_.flatData.at(changes_.pKeyMappedData.at(table).at(rowId));
+    Change& existingChange = changes_.flatData.edit(changes_.tableKeys.at(table).pKeys.at(rowId));
     switch (existingChange.getType()) {
     case ChangeType::DELETE_ROW:
         return existingChange;
@@ -59,7 +168,7 @@ Change& ChangeTracker::manageConflictL(Change& newChange) {
         [[fallthrough]];
     case ChangeType::UPDATE_CELLS:
         mergeCellChanges(existingChange, newChange);
-        dbService_.validateChange(existingChange, false);
+        db.validateChange(existingChange, false);
         return existingChange;
     default:
         break;
@@ -67,74 +176,244 @@ Change& ChangeTracker::manageConflictL(Change& newChange) {
     return existingChange;
 }
 
-void ChangeTracker::propagateValidity(Change& change) {
-    logDetail(std::format("Propagating validity for change {}.", change.getKey()));
-    if (change.hasChildren()) {
-        bool childSum = true;
-        for (const std::size_t& childKey : change.getChildren()) {
-            if (!changes_.flatData.contains(childKey)) { continue; }
-            childSum &= changes_.flatData.at(childKey).isValid();
-        }
-        change.setValidity(childSum);
-    }
-    if (change.hasParent()) {
-        for (const std::size_t& parentKey : change.getParents()) {
-            if (changes_.flatData.contains(parentKey)) { propagateValidity(changes_.flatData.at(parentKey)); }
-        }
-    }
+bool ChangeTracker::isUKeyTakenL(const Change& change, const DbSnapshot& db) {
+    // checks is there already exists a change, that has the same value in the ukey (name) column
+    const auto keys = changes_.tableKeys.find(change.getTable());
+    if (keys == changes_.tableKeys.end()) { return false; }
+    const std::string ukey = db.getTableUKey(change.getTable());
+    if (!keys->second.uKeys.contains(change.getCell(ukey))) { return false; }
+    logger_.pushLog(Log{std::format("ERROR: change with the same ukey (name): {} already exists", ukey)});
+    return true;
 }
 
 ChangeAddResult ChangeTracker::addChange(Change change, std::optional<uint32_t> existingRowId) {
+    METRIC_TIMER("tracker.addChange");
     logDetail(std::format("Attempting to add change to table {}.", change.getTable()));
+    const DbSnapshot db = dbService_.getSnapshot();
+    PreparedChange prepared = prepareChange(db, std::move(change), existingRowId);
+    std::map<std::string, std::size_t> rows;
     {
-        std::lock_guard<std::mutex> lg(changes_.mtx);
-        if (changes_.uKeyMappedData.contains(change.getTable())) {
-            // checks is there already exists a change, that has the same value in the ukey (name)
-            // column
-            const std::string ukey = dbService_.getTableUKey(change.getTable());
-            if (changes_.uKeyMappedData.at(change.getTable()).contains(change.getCell(ukey))) {
-                logger_.pushLog(Log{std::format("ERROR: change with the same ukey (name): {} already exists", ukey)});
-                return ChangeAddResult::ALREADY_EXISTING;
-            }
+        std::shared_lock<std::shared_mutex> lg(changes_.mtx);
+        if (isUKeyTakenL(prepared.change, db)) { return ChangeAddResult::ALREADY_EXISTING; }
+        countNewRowsL(prepared, db, rows);
+    }
+
+    ReservedIds ids = takeIds(rows);
+    waitIfFrozen();
+    std::lock_guard<std::shared_mutex> lg(changes_.mtx);
+    openEntryL();
+    std::vector<std::size_t> added;
+    const ChangeAddResult result = addPreparedL(prepared, added, db, ids);
+    settleValidityL(added);
+    closeEntryL();
+    persistL();
+    returnIds(ids);
+    return result;
+}
+
+std::vector<ChangeAddResult> ChangeTracker::addChanges(std::span<Change> changes) {
+    METRIC_TIMER("tracker.addChanges");
+    const DbSnapshot db = dbService_.getSnapshot();
+    std::vector<PreparedChange> prepared;
+    prepared.reserve(changes.size());
+    for (Change& change : changes) {
+        const std::optional<uint32_t> rowId = change.hasRowId() ? std::optional<uint32_t>{change.getRowId()} : std::nullopt;
+        prepared.push_back(prepareChange(db, std::move(change), rowId));
+    }
+
+    std::map<std::string, std::size_t> rows;
+    {
+        std::shared_lock<std::shared_mutex> lg(changes_.mtx);
+        for (const PreparedChange& p : prepared) {
+            countNewRowsL(p, db, rows);
         }
     }
+    ReservedIds ids = takeIds(rows);
 
-    if (!dbService_.validateChange(change, false)) { return ChangeAddResult::INVALID; }
+    std::vector<ChangeAddResult> results;
+    results.reserve(prepared.size());
+    waitIfFrozen();
+    std::lock_guard<std::shared_mutex> lg(changes_.mtx);
+    openEntryL();
+    std::vector<std::size_t> added;
+    for (PreparedChange& p : prepared) {
+        results.push_back(addPreparedL(p, added, db, ids));
+    }
+    settleValidityL(added);
+    closeEntryL();
+    persistL();
+    returnIds(ids);
+    return results;
+}
 
-    std::vector<Change> allChanges;
-    if (change.getType() == ChangeType::UPDATE_CELLS) {
+PreparedChange ChangeTracker::prepareChange(const DbSnapshot& db, Change change, std::optional<uint32_t> existingRowId) const {
+    PreparedChange prepared{std::move(change)};
+    prepared.valid = db.validateChange(prepared.change, false);
+    if (!prepared.valid) { return prepared; }
+
+    if (prepared.change.getType() == ChangeType::UPDATE_CELLS) {
         assert(existingRowId.has_value());
-        change.setRowId(*existingRowId);
+        prepared.change.setRowId(*existingRowId);
     }
+    prepared.required = db.getRequiredChanges(prepared.change, {});
+    return prepared;
+}
 
-    waitIfFrozen();
-    {
-        std::lock_guard<std::mutex> lg(changes_.mtx);
-        change = manageConflictL(change);
-        collectRequiredChangesL(change, allChanges);
+ChangeAddResult
+ChangeTracker::addPreparedL(PreparedChange& prepared, std::vector<std::size_t>& added, const DbSnapshot& db, ReservedIds& ids) {
+    if (isUKeyTakenL(prepared.change, db)) { return ChangeAddResult::ALREADY_EXISTING; }
+    if (!prepared.valid) { return ChangeAddResult::INVALID; }
+
+    // checked before anything is linked, running out halfway would leave pending changes pointing at rows never added
+    std::map<std::string, std::size_t> rows;
+    countNewRowsL(prepared, db, rows);
+    for (const auto& [table, count] : rows) {
+        const auto it = ids.find(table);
+        if (it != ids.end() && it->second.size() >= count) { continue; }
+        logger_.pushLog(Log{std::format("ERROR: No ids could be reserved for new rows of {}, the change was not added.", table)});
+        return ChangeAddResult::INTERNAL_FAILURE;
+    }
+
+    std::vector<Change> allChanges;
+    Change change = prepared.change;
+    if (isConflicting(change)) {
+        // merged into a pending change, whose required changes the preparation could not know
+        change = manageConflictL(change, db);
+        collectRequiredChangesL(change, allChanges, db);
+    } else {
+        collectRequiredChangesL(change, allChanges, std::move(prepared.required), db);
     }
-    allocateIds(allChanges);
+    if (!allocateIds(allChanges, ids)) { return ChangeAddResult::INTERNAL_FAILURE; }
 
-    std::lock_guard<std::mutex> lg(changes_.mtx);
     for (Change& c : allChanges) {
-        c = manageConflictL(c);
-        propagateValidity(c);
+        c = manageConflictL(c, db);
         if (!addChangeInternalL(c)) { return ChangeAddResult::INTERNAL_FAILURE; }
+        added.push_back(c.getKey());
     }
-
     return ChangeAddResult::SUCCESS;
 }
 
-void ChangeTracker::collectRequiredChangesL(Change& change, std::vector<Change>& out) {
+void ChangeTracker::recordValidityL(std::size_t key) {
+    Journal& journal = changes_.journal;
+    if (!journal.open || journal.validityRecorded.contains(key)) { return; }
+    journal.validityRecorded.insertOrAssign(key, true);
+    const ValidityCount* count = changes_.validity.find(key);
+    journal.open->validity.emplace_back(key, count ? std::optional<ValidityCount>{*count} : std::nullopt);
+}
+
+ValidityCount& ChangeTracker::validityL(std::size_t key) {
+    recordValidityL(key);
+    return changes_.validity[key];
+}
+
+void ChangeTracker::recountValidityL(Change& change) {
+    ValidityCount& count = validityL(change.getKey());
+    count.invalidChildren = 0;
+    for (const std::size_t childKey : change.getChildren()) {
+        const ValidityCount* child = changes_.validity.find(childKey);
+        if (child && !child->counted && changes_.flatData.contains(childKey)) { ++count.invalidChildren; }
+    }
+    if (change.hasChildren()) { change.setValidity(count.invalidChildren == 0); }
+}
+
+void ChangeTracker::publishValidityL(const Change& change, std::vector<std::size_t>& pending) {
+    ValidityCount& count = validityL(change.getKey());
+    if (count.counted == change.isValid()) { return; }
+    count.counted = change.isValid();
+    reportToParentsL(change, count.counted, pending);
+}
+
+void ChangeTracker::reportToParentsL(const Change& change, bool valid, std::vector<std::size_t>& pending) {
+    const std::vector<std::size_t>& parents = change.getParents();
+    for (auto it = parents.begin(); it != parents.end(); ++it) {
+        if (std::find(parents.begin(), it, *it) != it || !changes_.flatData.contains(*it)) { continue; }
+        // a parent holding this change twice counts it twice
+        const auto listed = static_cast<uint32_t>(std::ranges::count(changes_.flatData.at(*it).getChildren(), change.getKey()));
+        if (listed == 0) { continue; }
+        ValidityCount& parentCount = validityL(*it);
+        if (valid) {
+            parentCount.invalidChildren -= std::min(parentCount.invalidChildren, listed);
+        } else {
+            parentCount.invalidChildren += listed;
+        }
+        pending.push_back(*it);
+    }
+}
+
+void ChangeTracker::flushValidityL(std::vector<std::size_t>& pending) {
+    while (!pending.empty()) {
+        const std::size_t key = pending.back();
+        pending.pop_back();
+        if (!changes_.flatData.contains(key)) { continue; }
+        const bool valid = changes_.validity.at(key).invalidChildren == 0;
+        // a parent that keeps its validity stays untouched, and so do its ancestors and their snapshot tables
+        if (changes_.flatData.at(key).isValid() == valid) { continue; }
+        Change& change = changes_.flatData.edit(key);
+        change.setValidity(valid);
+        publishValidityL(change, pending);
+    }
+}
+
+void ChangeTracker::settleValidityL(const std::vector<std::size_t>& added) {
+    // Only added changes can have gained or lost children, they get recounted. From there on a change reaches its
+    // parents only when its validity flipped, instead of every ancestor being refreshed.
+    std::vector<std::size_t> pending;
+    for (const std::size_t key : added) {
+        if (!changes_.flatData.contains(key)) { continue; }
+        Change& change = changes_.flatData.edit(key);
+        recountValidityL(change);
+        publishValidityL(change, pending);
+    }
+    flushValidityL(pending);
+}
+
+std::vector<std::pair<std::size_t, ChangeAddResult>> ChangeTracker::addPrepared(std::vector<PreparedSequence>& sequences,
+                                                                               const DbSnapshot& db) {
+    METRIC_TIMER("tracker.addPrepared");
+    std::vector<std::pair<std::size_t, ChangeAddResult>> results;
+    std::map<std::string, std::size_t> rows;
+    {
+        std::shared_lock<std::shared_mutex> lg(changes_.mtx);
+        for (const PreparedSequence& sequence : sequences) {
+            for (const PreparedChange& prepared : sequence) {
+                countNewRowsL(prepared, db, rows);
+            }
+        }
+    }
+    ReservedIds ids = takeIds(rows);
+    waitIfFrozen();
+    std::lock_guard<std::shared_mutex> lg(changes_.mtx);
+    openEntryL();
+    std::vector<std::size_t> added;
+    for (PreparedSequence& sequence : sequences) {
+        for (PreparedChange& prepared : sequence) {
+            const std::size_t key = prepared.change.getKey();
+            const ChangeAddResult result = addPreparedL(prepared, added, db, ids);
+            results.emplace_back(key, result);
+            // a probe that got added makes the rest unnecessary, any other change that did not ends the sequence
+            if (prepared.probe == gotAdded(result)) { break; }
+        }
+    }
+    settleValidityL(added);
+    closeEntryL();
+    persistL();
+    returnIds(ids);
+    return results;
+}
+
+void ChangeTracker::collectRequiredChangesL(Change& change, std::vector<Change>& out, const DbSnapshot& db) {
+    collectRequiredChangesL(change, out, db.getRequiredChanges(change, changes_.maxPKeys), db);
+}
+
+void ChangeTracker::collectRequiredChangesL(Change& change, std::vector<Change>& out, std::vector<Change> required, const DbSnapshot& db) {
     logDetail(std::format("Collecting required changes for change {}.", change.getKey()));
-    std::vector<Change> required = dbService_.getRequiredChanges(change, changes_.maxPKeys);
     handleRequiredChildrenMismatch(change, required);
     for (Change& r : required) {
-        if (!dbService_.validateChange(r, true)) { return; }
-        std::size_t existingRequiredKey = findExistingRequired(r);
-        bool released = releaseDependancy(change, r);
+        if (!db.validateChange(r, true)) { return; }
+        std::size_t existingRequiredKey = findExistingRequired(r, db);
+        bool released = releaseDependancy(change, r, db);
         if (existingRequiredKey != 0) {
-            Change& existingChange = changes_.flatData.at(existingRequiredKey);
+            Change& existingChange = changes_.flatData.edit(existingRequiredKey);
             if (released) {
                 logDetail(std::format("Connecting change {} to existing change {}.", change.getKey(), existingChange.getKey()));
                 existingChange.addParent(change.getKey());
@@ -147,7 +426,7 @@ void ChangeTracker::collectRequiredChangesL(Change& change, std::vector<Change>&
             change.pushChild(r);
         }
         if (existingRequiredKey != 0) { continue; }
-        collectRequiredChangesL(r, out);
+        collectRequiredChangesL(r, out, db);
     }
     out.push_back(change);
 }
@@ -165,7 +444,7 @@ void ChangeTracker::handleRequiredChildrenMismatch(Change& change, std::vector<C
     std::size_t diffsHandled = 0;
     for (const std::size_t childKey : change.getChildren()) {
         if (sizeDiff == diffsHandled) { return; }
-        Change& child = changes_.flatData.at(childKey);
+        Change& child = changes_.flatData.edit(childKey);
         auto it = std::find_if(rChanges.begin(), rChanges.end(), [&](const Change& r) { return child.getTable() == r.getTable(); });
 
         // remove the child that is no longer in the required changes
@@ -177,19 +456,19 @@ void ChangeTracker::handleRequiredChildrenMismatch(Change& change, std::vector<C
     }
 }
 
-std::size_t ChangeTracker::findExistingRequired(const Change& rChange) {
+std::size_t ChangeTracker::findExistingRequired(const Change& rChange, const DbSnapshot& db) {
     // finds, if a change with the same resulting table ukey-value exists
     logDetail(std::format("Finding existing change  for required change {}.", rChange.getKey()));
     const std::string& table = rChange.getTable();
-    if (!changes_.uKeyMappedData.contains(table)) { return 0; }
-    const std::string& rChangeCellValue = rChange.getCell(dbService_.getTableUKey(table));
-    if (changes_.uKeyMappedData.at(table).contains(rChangeCellValue)) { return changes_.uKeyMappedData.at(table).at(rChangeCellValue); }
-    return 0;
+    const auto keys = changes_.tableKeys.find(table);
+    if (keys == changes_.tableKeys.end()) { return 0; }
+    const std::size_t* existingKey = keys->second.uKeys.find(rChange.getCell(db.getTableUKey(table)));
+    return existingKey ? *existingKey : 0;
 }
 
 void ChangeTracker::releaseAllDependancies(Change& change) {
     for (const std::size_t& childKey : change.getChildren()) {
-        Change& child = changes_.flatData.at(childKey);
+        Change& child = changes_.flatData.edit(childKey);
         change.removeChild(childKey);
         child.removeParent(change.getKey());
         // add to roots if it now has no parents
@@ -197,17 +476,17 @@ void ChangeTracker::releaseAllDependancies(Change& change) {
     }
 }
 
-bool ChangeTracker::releaseDependancy(Change& change, const Change& rC) {
+bool ChangeTracker::releaseDependancy(Change& change, const Change& rC, const DbSnapshot& db) {
     logDetail(std::format("Attempting to release dependency between change {} and {}.", change.getKey(), rC.getKey()));
 
     const std::string& rCTableName = rC.getTable();
-    const std::string rCUKeyHeader = dbService_.getTableUKey(rCTableName);
+    const std::string rCUKeyHeader = db.getTableUKey(rCTableName);
     const std::string& rCUKeyValue = "";
     std::string newRValue;
 
     // find new equivalent value corresponding to the old ukey-value of rC
     for (const auto& [col, val] : change.getCells()) {
-        HeaderInfo headerInfoChange = dbService_.getTableHeaderInfo(change.getTable(), col);
+        HeaderInfo headerInfoChange = db.getTableHeaderInfo(change.getTable(), col);
         if (headerInfoChange.referencedTable == rCTableName) {
             newRValue = val;
             break;
@@ -220,7 +499,7 @@ bool ChangeTracker::releaseDependancy(Change& change, const Change& rC) {
     bool hadRelevantChildren = false;
     for (const std::size_t& childKey : change.getChildren()) {
         if (!changes_.flatData.contains(childKey)) { continue; } // not created yet
-        Change& child = changes_.flatData.at(childKey);
+        Change& child = changes_.flatData.edit(childKey);
         if (child.getTable() != rCTableName) { continue; } // wrong child
         hadRelevantChildren = true;
         if (child.getCell(rCUKeyHeader) != newRValue) { // previous requiredChange found
@@ -234,22 +513,101 @@ bool ChangeTracker::releaseDependancy(Change& change, const Change& rC) {
     return !hadRelevantChildren;
 }
 
-void ChangeTracker::allocateIds(std::vector<Change>& allChanges) {
+void ChangeTracker::countNewRows(const Change& change, const DbSnapshot& db, std::map<std::string, std::size_t>& rows) const {
+    if (!change.hasRowId()) { ++rows[change.getTable()]; }
+    for (const Change& required : db.getRequiredChanges(change, {})) {
+        countNewRows(required, db, rows);
+    }
+}
+
+void ChangeTracker::countNewRowsL(const PreparedChange& prepared, const DbSnapshot& db, std::map<std::string, std::size_t>& rows) {
+    // At most as many as the change adds, required rows that turn out pending already take none. Counted as
+    // collectRequiredChangesL will find them, a merge into a pending change asks with the merged cells.
+    if (!dbService_.reservesIds() || !prepared.valid) { return; }
+    if (isConflicting(prepared.change)) {
+        Change merged = changes_.flatData.at(changes_.tableKeys.at(prepared.change.getTable()).pKeys.at(prepared.change.getRowId()));
+        if (merged.getType() != ChangeType::DELETE_ROW) { merged ^ prepared.change; }
+        for (const Change& required : db.getRequiredChanges(merged, {})) {
+            countNewRows(required, db, rows);
+        }
+        return;
+    }
+    if (!prepared.change.hasRowId()) { ++rows[prepared.change.getTable()]; }
+    for (const Change& required : prepared.required) {
+        countNewRows(required, db, rows);
+    }
+}
+
+bool ChangeTracker::allocateIds(std::vector<Change>& allChanges, ReservedIds& ids) {
     for (Change& c : allChanges) {
-        if (!c.hasRowId()) { c.setRowId(++changes_.maxPKeys[c.getTable()]); }
+        if (c.hasRowId()) { continue; }
+        std::size_t& maxPKey = changes_.maxPKeys[c.getTable()];
+        if (!dbService_.reservesIds()) {
+            c.setRowId(static_cast<uint32_t>(++maxPKey));
+            continue;
+        }
+        // a counted id would collide with the sequence, the caller made sure there are enough
+        std::vector<std::size_t>& free = ids[c.getTable()];
+        if (free.empty()) {
+            logger_.pushLog(Log{std::format("ERROR: No reserved id left for a new row of {}.", c.getTable())});
+            return false;
+        }
+        c.setReservedRowId(static_cast<uint32_t>(free.back()));
+        maxPKey = std::max(maxPKey, free.back());
+        free.pop_back();
+    }
+    return true;
+}
+
+ReservedIds ChangeTracker::takeIds(const std::map<std::string, std::size_t>& rows) {
+    // before the tracker lock, the round trip to the database must not block it
+    ReservedIds ids;
+    if (rows.empty()) { return ids; }
+    std::lock_guard<std::mutex> lg(idMtx_);
+    for (const auto& [table, count] : rows) {
+        IdPool& pool = idPools_[table];
+        if (pool.ids.size() < count) { topUpIds(pool, table, count - pool.ids.size()); }
+        // a failed reservation leaves fewer, the change needing them is then not added
+        const std::size_t taken = std::min(count, pool.ids.size());
+        ids[table].assign(pool.ids.end() - static_cast<std::ptrdiff_t>(taken), pool.ids.end());
+        pool.ids.resize(pool.ids.size() - taken);
+    }
+    return ids;
+}
+
+void ChangeTracker::topUpIds(IdPool& pool, const std::string& table, std::size_t missing) {
+    // blocks grow with use, an import needs few round trips and a single edit wastes few ids
+    pool.nextBlock = std::clamp(pool.nextBlock * 2, MIN_ID_BLOCK, MAX_ID_BLOCK);
+    std::vector<std::size_t> ids = dbService_.reserveIds(table, std::max(missing, pool.nextBlock));
+    std::ranges::sort(ids, std::greater<>{});
+    // the ids left over are older and smaller, they go first
+    ids.insert(ids.end(), pool.ids.begin(), pool.ids.end());
+    pool.ids = std::move(ids);
+}
+
+void ChangeTracker::returnIds(ReservedIds& ids) {
+    // ids a change did not use after all, rows that were pending already or a sequence that ended early
+    std::lock_guard<std::mutex> lg(idMtx_);
+    for (auto& [table, free] : ids) {
+        if (free.empty()) { continue; }
+        IdPool& pool = idPools_[table];
+        pool.ids.insert(pool.ids.end(), free.begin(), free.end());
+        std::ranges::sort(pool.ids, std::greater<>{});
     }
+    ids.clear();
 }
 
-bool ChangeTracker::addChangeInternalL(const Change& change) {
-    const std::string tableName = change.getTable();
-    changes_.flatData.insert_or_assign(change.getKey(), change);
-    changes_.pKeyMappedData[tableName].insert_or_assign(change.getRowId(), change.getKey());
+bool ChangeTracker::addChangeInternalL(Change change) {
+    const std::string& tableName = change.getTable();
+    TableKeys& keys = changes_.tableKeys[tableName];
+    keys.pKeys.insertOrAssign(change.getRowId(), change.getKey());
     // store ukey value to prevent duplicates
-    const std::string changeUKeyValue = change.getCell(dbService_.getTableUKey(tableName));
-    if (!changeUKeyValue.empty()) { changes_.uKeyMappedData[tableName].insert_or_assign(changeUKeyValue, change.getKey()); }
+    std::string changeUKeyValue = change.getCell(dbService_.getTableUKey(tableName));
+    if (!changeUKeyValue.empty()) { keys.uKeys.insertOrAssign(std::move(changeUKeyValue), change.getKey()); }
     // store as root if no parent
     if (!change.hasParent()) { changes_.roots.insert(change.getKey()); }
-    logger_.pushLog(Log{std::format("    Adding change {} to table {} at id {}", change.getKey(), change.getTable(), change.getRowId())});
+    logger_.log<LogLevel::DEBUG>("    Adding change {} to table {} at id {}", change.getKey(), change.getTable(), change.getRowId());
+    changes_.flatData.insertOrAssign(std::move(change));
     return true;
 }
 
@@ -260,127 +618,421 @@ void ChangeTracker::collectAllDescendants(std::size_t key, std::unordered_set<st
     collected.insert(key);
     for (std::size_t childKey : change.getChildren()) {
         collectAllDescendants(childKey, collected);
-        changes_.flatData.at(childKey).removeParent(key);
+        changes_.flatData.edit(childKey).removeParent(key);
     }
 }
 
 void ChangeTracker::removeChanges(const std::size_t changeKey) {
     waitIfFrozen();
     std::unordered_set<std::size_t> toRemove;
-    std::lock_guard<std::mutex> lg(changes_.mtx);
+    std::lock_guard<std::shared_mutex> lg(changes_.mtx);
+    openEntryL();
     collectAllDescendants(changeKey, toRemove);
-    for (std::size_t key : toRemove) {
-        removeChangeL(key);
-    }
+    removeChangesL(toRemove);
+    closeEntryL();
+    persistL();
 }
 
 void ChangeTracker::removeChanges(const Change::chHashV& changeHashes) {
     waitIfFrozen();
     std::unordered_set<std::size_t> toRemove;
-    std::lock_guard<std::mutex> lg(changes_.mtx);
+    std::lock_guard<std::shared_mutex> lg(changes_.mtx);
+    openEntryL();
     for (std::size_t key : changeHashes) {
         collectAllDescendants(key, toRemove);
     }
-    for (std::size_t key : toRemove) {
-        removeChangeL(key);
+    removeChangesL(toRemove);
+    closeEntryL();
+    persistL();
+}
+
+std::shared_ptr<const uiChangeInfo> ChangeTracker::getSnapShot() {
+    METRIC_TIMER("tracker.getSnapShot");
+    {
+        // the per frame case, nothing changed since the last snapshot
+        std::shared_lock<std::shared_mutex> lgChanges(changes_.mtx);
+        if (changes_.snapshot && changes_.snapshot->version == changes_.flatData.version()) { return changes_.snapshot; }
+    }
+    std::lock_guard<std::shared_mutex> lgChanges(changes_.mtx);
+    const std::shared_ptr<const uiChangeInfo>& previous = changes_.snapshot;
+    if (previous && previous->version == changes_.flatData.version()) { return previous; }
+
+    auto info = std::make_shared<uiChangeInfo>();
+    info->version = changes_.flatData.version();
+    info->roots = changes_.roots;
+    if (previous) { info->tables = previous->tables; }
+
+    // only tables written since the previous version get copied, each from its own keys
+    for (const std::string& tableName : changes_.flatData.takeDirtyTables()) {
+        auto tableChanges = std::make_shared<uiTableChanges>();
+        for (const auto& [rowId, changeKey] : changes_.tableKeys.at(tableName).pKeys) {
+            tableChanges->idMappedChanges.emplace(rowId, changeKey);
+            if (const Change* change = changes_.flatData.find(changeKey)) { tableChanges->changes.emplace(changeKey, *change); }
+        }
+        info->tables.insert_or_assign(tableName, std::move(tableChanges));
     }
+
+    changes_.snapshot = info;
+    return info;
 }
 
-uiChangeInfo ChangeTracker::getSnapShot() {
-    std::lock_guard<std::mutex> lgChanges(changes_.mtx);
-    return uiChangeInfo{changes_.pKeyMappedData, changes_.flatData, changes_.roots};
+void ChangeTracker::removeChangesL(const std::unordered_set<std::size_t>& keys) {
+    std::set<std::string> staleMaxPKeys;
+    std::vector<std::size_t> pending;
+    for (std::size_t key : keys) {
+        removeChangeL(key, staleMaxPKeys, pending);
+    }
+    flushValidityL(pending);
+    // once per table, removing in descending order would otherwise rescan the table per change
+    for (const std::string& tableName : staleMaxPKeys) {
+        const TableKeys& tableKeys = changes_.tableKeys.at(tableName);
+        if (tableKeys.pKeys.empty()) {
+            const auto initial = initialMaxPKeys_.find(tableName);
+            changes_.maxPKeys[tableName] = initial == initialMaxPKeys_.end() ? 0 : initial->second;
+            continue;
+        }
+        std::size_t maxPKey = 0;
+        for (const auto& [rowId, changeKey] : tableKeys.pKeys) {
+            maxPKey = std::max(maxPKey, rowId);
+        }
+        changes_.maxPKeys[tableName] = maxPKey;
+    }
 }
 
-void ChangeTracker::removeChangeL(std::size_t key) {
+void ChangeTracker::removeChangeL(std::size_t key, std::set<std::string>& staleMaxPKeys, std::vector<std::size_t>& pending) {
     if (!changes_.flatData.contains(key)) { return; };
     const Change& change = changes_.flatData.at(key);
+    // parents that stay behind stop waiting for it
+    const ValidityCount* count = changes_.validity.find(key);
+    if (count && !count->counted) { reportToParentsL(change, true, pending); }
+    recordValidityL(key);
+    changes_.validity.erase(key);
     const std::string& tableName = change.getTable();
-    auto& pkeyMap = changes_.pKeyMappedData.at(tableName);
+    TableKeys& keys = changes_.tableKeys.at(tableName);
     // remove ukey-entry if it exists
-    if (changes_.uKeyMappedData.contains(tableName)) {
-        auto& ukeyMap = changes_.uKeyMappedData.at(tableName);
-        ukeyMap.erase(change.getCell(dbService_.getTableUKey(tableName)));
-    }
-    pkeyMap.erase(change.getRowId());
-    if (change.getRowId() == changes_.maxPKeys.at(tableName)) {
-        if (!pkeyMap.empty()) {
-            changes_.maxPKeys[tableName] = pkeyMap.rbegin()->first;
+    keys.uKeys.erase(change.getCell(dbService_.getTableUKey(tableName)));
+    keys.pKeys.erase(change.getRowId());
+    const auto maxPKey = changes_.maxPKeys.find(tableName);
+    if (maxPKey != changes_.maxPKeys.end() && change.getRowId() == maxPKey->second) { staleMaxPKeys.insert(tableName); }
+
+    changes_.roots.erase(key);
+
+    logger_.log<LogLevel::DEBUG>("    Removing change {}", key);
+    changes_.flatData.erase(key);
+}
+
+void ChangeTracker::openEntryL() {
+    Journal& journal = changes_.journal;
+    if (journal.open) { return; } // a group is open, the operation joins its entry
+    journal.open = JournalImages{};
+    journal.open->maxPKeys = changes_.maxPKeys;
+    changes_.flatData.startRecording();
+}
+
+void ChangeTracker::closeEntryL() {
+    Journal& journal = changes_.journal;
+    if (!journal.open || journal.groups > 0) { return; }
+    JournalImages entry = std::move(*journal.open);
+    journal.open.reset();
+    journal.validityRecorded.clear();
+    entry.changes = changes_.flatData.stopRecording();
+    // rejected changes leave nothing to undo
+    if (entry.changes.empty() && entry.validity.empty() && entry.maxPKeys == changes_.maxPKeys) { return; }
+    journal.undo.push_back(std::move(entry));
+    if (journal.undo.size() > MAX_JOURNAL_ENTRIES) { journal.undo.pop_front(); }
+    journal.redo.clear();
+}
+
+void ChangeTracker::clearJournalL() {
+    Journal& journal = changes_.journal;
+    journal.undo.clear();
+    journal.redo.clear();
+    if (!journal.open) { return; }
+    // operations of a group still open start a new entry
+    journal.open.reset();
+    journal.validityRecorded.clear();
+    changes_.flatData.stopRecording();
+}
+
+JournalImages ChangeTracker::swapImagesL(JournalImages images) {
+    // Changes move out of the store and the images move in, nothing is copied. All touched changes leave first, an
+    // image may bring back a row id or ukey another touched change holds now.
+    JournalImages current;
+    current.changes.reserve(images.changes.size());
+    for (const auto& [key, image] : images.changes) {
+        const Change* change = changes_.flatData.find(key);
+        if (change) {
+            TableKeys& keys = changes_.tableKeys.at(change->getTable());
+            const std::size_t* pKeyOwner = keys.pKeys.find(change->getRowId());
+            if (pKeyOwner && *pKeyOwner == key) { keys.pKeys.erase(change->getRowId()); }
+            const std::string& uKeyValue = change->getCell(dbService_.getTableUKey(change->getTable()));
+            const std::size_t* uKeyOwner = keys.uKeys.find(uKeyValue);
+            if (uKeyOwner && *uKeyOwner == key) { keys.uKeys.erase(uKeyValue); }
+            changes_.roots.erase(key);
+        }
+        current.changes.emplace_back(key, changes_.flatData.take(key));
+    }
+    for (auto& [key, image] : images.changes) {
+        if (image) { addChangeInternalL(std::move(*image)); }
+    }
+
+    current.validity.reserve(images.validity.size());
+    for (const auto& [key, count] : images.validity) {
+        const ValidityCount* now = changes_.validity.find(key);
+        current.validity.emplace_back(key, now ? std::optional<ValidityCount>{*now} : std::nullopt);
+        if (count) {
+            changes_.validity.insertOrAssign(key, *count);
         } else {
-            changes_.maxPKeys[tableName] = initialMaxPKeys_.at(tableName);
+            changes_.validity.erase(key);
         }
     }
+    current.maxPKeys = std::exchange(changes_.maxPKeys, std::move(images.maxPKeys));
+    return current;
+}
 
-    changes_.roots.erase(key);
+bool ChangeTracker::replayL(std::deque<JournalImages>& from, std::deque<JournalImages>& to) {
+    if (from.empty() || changes_.journal.open) { return false; }
+    JournalImages images = std::move(from.back());
+    from.pop_back();
+    // what the same changes look like now is the way back
+    to.push_back(swapImagesL(std::move(images)));
+    persistL();
+    return true;
+}
 
-    logger_.pushLog(Log{std::format("    Removing change {}", key)});
-    changes_.flatData.erase(key);
+void ChangeTracker::beginJournalGroup() {
+    std::lock_guard<std::shared_mutex> lg(changes_.mtx);
+    ++changes_.journal.groups;
+    openEntryL();
+}
+
+void ChangeTracker::endJournalGroup() {
+    std::lock_guard<std::shared_mutex> lg(changes_.mtx);
+    if (changes_.journal.groups == 0) { return; }
+    --changes_.journal.groups;
+    closeEntryL();
+}
+
+bool ChangeTracker::undo() {
+    METRIC_TIMER("tracker.undo");
+    waitIfFrozen();
+    std::lock_guard<std::shared_mutex> lg(changes_.mtx);
+    return replayL(changes_.journal.undo, changes_.journal.redo);
+}
+
+bool ChangeTracker::redo() {
+    METRIC_TIMER("tracker.redo");
+    waitIfFrozen();
+    std::lock_guard<std::shared_mutex> lg(changes_.mtx);
+    return replayL(changes_.journal.redo, changes_.journal.undo);
+}
+
+bool ChangeTracker::canUndo() {
+    std::shared_lock<std::shared_mutex> lg(changes_.mtx);
+    return !changes_.journal.undo.empty() && !changes_.journal.open;
+}
+
+bool ChangeTracker::canRedo() {
+    std::shared_lock<std::shared_mutex> lg(changes_.mtx);
+    return !changes_.journal.redo.empty() && !changes_.journal.open;
+}
+
+void ChangeTracker::clearJournal() {
+    std::lock_guard<std::shared_mutex> lg(changes_.mtx);
+    clearJournalL();
+}
+
+void ChangeTracker::persistL() {
+    const std::vector<std::size_t> written = changes_.flatData.takeWritten();
+    if (!log_.isOpen()) { return; }
+    log_.append(written, changes_.flatData);
+    if (log_.wantsCompaction(changes_.flatData.size())) { log_.compact(changes_.flatData); }
+}
+
+bool ChangeTracker::isRecoverableL(Change& change) const {
+    if (!change.hasRowId() || !dbService_.validateChange(change, true)) { return false; }
+    const std::string& table = change.getTable();
+    for (const auto& [column, value] : change.getCells()) {
+        if (!dbService_.hasColumn(table, column.str())) { return false; }
+    }
+    if (change.getType() == ChangeType::INSERT_ROW) {
+        // a row with the id means it was applied already, or the id was taken meanwhile
+        if (dbService_.checkReferencedPKeyValue(table, std::to_string(change.getRowId()))) { return false; }
+        if (change.hasReservedRowId()) { return true; }
+        // no maximum is loaded when ids come from the sequence, which may have handed out this counted one since
+        if (dbService_.reservesIds()) { return false; }
+        // a row inserted since may hold a counted up id without being loaded yet
+        const auto it = initialMaxPKeys_.find(table);
+        return it == initialMaxPKeys_.end() || change.getRowId() > it->second;
+    }
+    return dbService_.checkReferencedPKeyValue(table, std::to_string(change.getRowId()));
+}
+
+std::size_t ChangeTracker::recoverL(std::vector<Change> logged) {
+    std::unordered_map<std::size_t, const Change*> byKey;
+    for (const Change& change : logged) {
+        byKey.emplace(change.getKey(), &change);
+    }
+    // a change the snapshot no longer allows goes, and with it every change needing it
+    std::vector<std::size_t> stack;
+    for (Change& change : logged) {
+        const bool childMissing = std::ranges::any_of(change.getChildren(), [&](std::size_t child) { return !byKey.contains(child); });
+        if (childMissing || !isRecoverableL(change)) { stack.push_back(change.getKey()); }
+    }
+    std::unordered_set<std::size_t> dropped;
+    while (!stack.empty()) {
+        const std::size_t key = stack.back();
+        stack.pop_back();
+        if (!dropped.insert(key).second) { continue; }
+        const auto it = byKey.find(key);
+        if (it != byKey.end()) { stack.insert(stack.end(), it->second->getParents().begin(), it->second->getParents().end()); }
+    }
+
+    std::vector<std::size_t> added;
+    changes_.flatData.reserve(logged.size());
+    changes_.validity.reserve(logged.size());
+    for (Change& change : logged) {
+        if (dropped.contains(change.getKey())) { continue; }
+        const auto isGone = [&](std::size_t parent) { return !byKey.contains(parent) || dropped.contains(parent); };
+        if (std::ranges::any_of(change.getParents(), isGone)) {
+            for (const std::size_t parent : std::vector<std::size_t>{change.getParents()}) {
+                if (isGone(parent)) { change.removeParent(parent); }
+            }
+        }
+        if (change.getType() == ChangeType::INSERT_ROW) {
+            std::size_t& maxPKey = changes_.maxPKeys[change.getTable()];
+            maxPKey = std::max<std::size_t>(maxPKey, change.getRowId());
+        }
+        added.push_back(change.getKey());
+        addChangeInternalL(std::move(change));
+    }
+    settleValidityL(added);
+    if (added.size() < logged.size()) {
+        logger_.pushLog(Log{std::format("WARNING: Dropped {} saved changes the database no longer allows, or that needed one of them.",
+                                        logged.size() - added.size())});
+    }
+    return added.size();
+}
+
+std::size_t ChangeTracker::openChangeLog(const std::filesystem::path& path) {
+    METRIC_TIMER("tracker.openChangeLog");
+    waitIfFrozen();
+    std::lock_guard<std::shared_mutex> lg(changes_.mtx);
+    if (log_.isOpen() || changes_.flatData.size() != 0) {
+        logger_.pushLog(Log{"ERROR: The change log can only be opened once and before any change was added."});
+        return 0;
+    }
+    std::optional<std::vector<Change>> logged = log_.load(path, dbService_);
+    if (!logged) { return 0; }
+    const std::size_t loggedCount = logged->size();
+    const std::size_t recovered = recoverL(std::move(*logged));
+    // the file starts over with what came back, dropped changes stay dropped
+    log_.compact(changes_.flatData);
+    changes_.flatData.trackWrites();
+    if (loggedCount > 0) {
+        logger_.pushLog(Log{std::format("Recovered {} of {} saved changes from {}.", recovered, loggedCount, path.string())});
+    }
+    return recovered;
 }
 
 void ChangeTracker::setMaxPKeys(std::map<std::string, std::size_t> pk) {
-    std::lock_guard<std::mutex> lgChanges(changes_.mtx);
+    std::lock_guard<std::shared_mutex> lgChanges(changes_.mtx);
     changes_.maxPKeys = pk;
     initialMaxPKeys_ = pk;
+    // ids handed out so far no longer line up with the database
+    clearJournalL();
 }
 
-std::size_t ChangeTracker::getMaxPKey(const std::string table) {
-    std::lock_guard<std::mutex> lgChanges(changes_.mtx);
+void ChangeTracker::raiseMaxPKeys(const std::map<std::string, std::size_t>& rowIds) {
+    std::lock_guard<std::shared_mutex> lgChanges(changes_.mtx);
+    for (const auto& [table, rowId] : rowIds) {
+        std::size_t& initial = initialMaxPKeys_[table];
+        initial = std::max(initial, rowId);
+        std::size_t& current = changes_.maxPKeys[table];
+        current = std::max(current, rowId);
+    }
+}
 
-    if (!changes_.maxPKeys.contains(table)) { return 0; }
-    return changes_.maxPKeys[table];
+std::size_t ChangeTracker::getMaxPKey(const std::string table) {
+    std::shared_lock<std::shared_mutex> lgChanges(changes_.mtx);
+    const auto it = changes_.maxPKeys.find(table);
+    return it == changes_.maxPKeys.end() ? 0 : it->second;
 }
 
 bool ChangeTracker::isChangeSelected(const std::size_t key) {
-    std::lock_guard<std::mutex> lgChanges(changes_.mtx);
+    std::shared_lock<std::shared_mutex> lgChanges(changes_.mtx);
     if (!changes_.flatData.contains(key)) { return false; }
     return changes_.flatData.at(key).isSelected();
 }
 
 void ChangeTracker::toggleChangeSelect(const std::size_t key) {
-    std::lock_guard<std::mutex> lgChanges(changes_.mtx);
+    std::lock_guard<std::shared_mutex> lgChanges(changes_.mtx);
     if (!changes_.flatData.contains(key)) { return; }
     if (changes_.flatData.at(key).hasParent()) { return; }
-    setChangeRecL(changes_.flatData.at(key), !changes_.flatData.at(key).isSelected());
-    return;
+    setChangeRecL(changes_.flatData.edit(key), !changes_.flatData.at(key).isSelected());
+    persistL();
 }
 
 void ChangeTracker::setChangeRecL(Change& change, bool value) {
     // if (change.getParents().size() > 1) { return; }
     change.setSelected(value);
     for (const std::size_t& childKey : change.getChildren()) {
-        Change& childChange = changes_.flatData.at(childKey);
+        Change& childChange = changes_.flatData.edit(childKey);
         setChangeRecL(childChange, value);
     }
 }
 
 bool ChangeTracker::hasChild(const std::size_t key) {
-    std::lock_guard<std::mutex> lgChanges(changes_.mtx);
-    if (!changes_.flatData.contains(key)) { return false; }
-    return changes_.flatData.at(key).hasChildren();
+    std::shared_lock<std::shared_mutex> lgChanges(changes_.mtx);
+    const Change* change = changes_.flatData.find(key);
+    return change && change->hasChildren();
 }
 
 std::vector<std::size_t> ChangeTracker::getChildren(const std::size_t key) {
-    if (hasChild(key)) {
-        std::lock_guard<std::mutex> lgChanges(changes_.mtx);
-        return changes_.flatData.at(key).getChildren();
+    std::shared_lock<std::shared_mutex> lgChanges(changes_.mtx);
+    const Change* change = changes_.flatData.find(key);
+    return change ? change->getChildren() : std::vector<std::size_t>{};
+}
+
+std::vector<Change> ChangeTracker::collectSubtrees(std::span<const std::size_t> roots) {
+    std::shared_lock<std::shared_mutex> lgChanges(changes_.mtx);
+    std::unordered_set<std::size_t> visited;
+    std::vector<Change> order;
+    for (const std::size_t root : roots) {
+        collectSubtreeL(root, visited, order);
+    }
+    return order;
+}
+
+void ChangeTracker::collectSubtreeL(std::size_t key, std::unordered_set<std::size_t>& visited, std::vector<Change>& order) const {
+    if (!visited.insert(key).second) { return; }
+    const Change* change = changes_.flatData.find(key);
+    if (!change) {
+        logger_.pushLog(Log{std::format("ERROR: Change with key {} not found.", key)});
+        return;
+    }
+    for (const std::size_t childKey : change->getChildren()) {
+        collectSubtreeL(childKey, visited, order);
     }
-    return std::vector<std::size_t>{};
+    order.push_back(*change);
 }
 
 std::vector<std::size_t> ChangeTracker::getCalcRoots() {
-    std::lock_guard<std::mutex> lgChanges(changes_.mtx);
+    std::shared_lock<std::shared_mutex> lgChanges(changes_.mtx);
     std::vector<std::size_t> all;
     std::size_t count = changes_.flatData.size();
     all.reserve(count);
 
-    for (auto it = changes_.flatData.begin(); it != changes_.flatData.end(); ++it) {
-        if (!it->second.hasParent()) { all.push_back(it->first); }
+    for (const Change& change : changes_.flatData) {
+        if (!change.hasParent()) { all.push_back(change.getKey()); }
     }
-
+    // storage order is not insertion order, execution relies on ascending keys
+    std::ranges::sort(all);
     return all;
 }
 
 std::unordered_set<std::size_t> ChangeTracker::getRoots() {
-    std::lock_guard<std::mutex> lgChanges(changes_.mtx);
+    std::shared_lock<std::shared_mutex> lgChanges(changes_.mtx);
     return changes_.roots;
 }
 
@@ -390,6 +1042,6 @@ bool ChangeTracker::gotAdded(ChangeAddResult result) {
 
 void ChangeTracker::logDetail(std::string content) {
 #ifdef WITH_DETAILED_LOG
-    logger_.pushLog(Log{std::format("      INTERNAL: {}", std::move(content))});
+    logger_.log<LogLevel::TRACE>("      INTERNAL: {}", content);
 #endif
 }
\ No newline at end of file
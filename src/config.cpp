@@ -1,5 +1,8 @@
 #include "config.hpp"
+
+#ifdef _WIN32
 #include "windows.h"
+#endif
 
 std::string Config::databaseJsonToDbString(const nlohmann::json& j) {
     try {
@@ -43,12 +46,47 @@ void Config::getAdditionalConfig(const nlohmann::json& j) {
             if (j["bom"].contains("mappingArchive")) { bom_.mappingArchive = j["bom"]["mappingArchive"].get<std::filesystem::path>(); }
         }
 
+        // CSV TYPE INFERENCE
+        if (j.contains("typeSampling")) {
+            typeSampling_.headRows = j["typeSampling"].value("headRows", std::size_t{0});
+            typeSampling_.sampledRows = j["typeSampling"].value("sampledRows", std::size_t{0});
+        }
+
+        // LOGGING
+        if (j.contains("logging")) {
+            const nlohmann::json& logging = j["logging"];
+            if (logging.contains("level")) {
+                const std::string level = logging["level"].get<std::string>();
+                if (auto parsed = logLevelFromString(level)) {
+                    logger_.setMinLevel(*parsed);
+                } else {
+                    logger_.pushLog(Log{std::format("WARNING: Unknown log level {}, expected trace, debug, info, warning or error.",
+                                                    level)});
+                }
+            }
+            if (logging.contains("retention")) { logger_.setRetention(logging["retention"].get<std::size_t>()); }
+            if (logging.contains("trace")) { logger_.startTrace(logging["trace"].get<std::filesystem::path>()); }
+        }
+
         // AUTO INV ARCHIVE
         if (j.contains("archivePath")) {
             autoInvArchivePath = j["archivePath"].get<std::filesystem::path>();
         } else {
             logger_.pushLog(Log{"INFORMATION: Archive-path not specified, no history possible."});
         }
+
+        // PENDING CHANGES
+        if (j.contains("pendingChangesPath")) {
+            pendingChangesPath_ = j["pendingChangesPath"].get<std::filesystem::path>();
+        } else {
+            logger_.pushLog(Log{"INFORMATION: Pending-changes-path not specified, pending changes are lost on exit."});
+        }
+
+        // ROW IDS
+        if (j.contains("reserveIds")) { reserveIds_ = j["reserveIds"].get<bool>(); }
+
+        // CONFLICTS
+        if (j.contains("checkConflicts")) { checkConflicts_ = j["checkConflicts"].get<bool>(); }
     } catch (const nlohmann::json::parse_error& e) { logger_.pushLog(Log{std::format("ERROR: Could not parse {}", e.what())}); }
 }
 
@@ -211,9 +249,16 @@ void Config::saveMappings(const std::vector<AutoInv::MappingNumber>& mappingsBom
 }
 
 std::filesystem::path Config::getExeDir() {
+#ifdef _WIN32
     char buffer[MAX_PATH];
     GetModuleFileName(nullptr, buffer, MAX_PATH);
     return std::filesystem::path(buffer).parent_path();
+#else
+    std::error_code ec;
+    std::filesystem::path exe = std::filesystem::read_symlink("/proc/self/exe", ec);
+    if (ec) { return std::filesystem::current_path(); }
+    return exe.parent_path();
+#endif
 }
 
 const std::string& Config::getFont() const {
@@ -250,4 +295,20 @@ std::filesystem::path Config::getCsvPathBom() const {
 
 std::filesystem::path Config::getAutoInvArchivePath() const {
     return autoInvArchivePath;
-}
\ No newline at end of file
+}
+
+std::filesystem::path Config::getPendingChangesPath() const {
+    return pendingChangesPath_;
+}
+
+bool Config::getReserveIds() const {
+    return reserveIds_;
+}
+
+bool Config::getCheckConflicts() const {
+    return checkConflicts_;
+}
+
+const CSV::TypeSampling& Config::getTypeSampling() const {
+    return typeSampling_;
+}
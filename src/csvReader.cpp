@@ -0,0 +1,243 @@
+#include "csvReader.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+
+#ifdef _WIN32
+#include "windows.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr std::string_view UTF8_BOM{"\xEF\xBB\xBF"};
+} // namespace
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (data_) { UnmapViewOfFile(data_); }
+    if (mapping_) { CloseHandle(mapping_); }
+    if (file_) { CloseHandle(file_); }
+    mapping_ = nullptr;
+    file_ = nullptr;
+#else
+    if (data_) { munmap(const_cast<char*>(data_), size_); }
+#endif
+    data_ = nullptr;
+    size_ = 0;
+}
+
+bool MappedFile::open(const std::filesystem::path& path) {
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileW(
+        path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) { return false; }
+    file_ = file;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        close();
+        return false;
+    }
+    if (size.QuadPart == 0) { return true; }
+    mapping_ = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_) {
+        close();
+        return false;
+    }
+    data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (!data_) {
+        close();
+        return false;
+    }
+    size_ = static_cast<std::size_t>(size.QuadPart);
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) { return false; }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        return false;
+    }
+    if (info.st_size > 0) {
+        void* mapped = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            ::close(fd);
+            return false;
+        }
+        madvise(mapped, static_cast<std::size_t>(info.st_size), MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(mapped);
+        size_ = static_cast<std::size_t>(info.st_size);
+    }
+    ::close(fd); // the mapping keeps the file alive
+#endif
+    return true;
+}
+
+std::string_view MappedFile::view() const {
+    return data_ ? std::string_view{data_, size_} : std::string_view{};
+}
+
+char* CsvArena::allocate(std::size_t size) {
+    if (size == 0) { return nullptr; }
+    if (size > BLOCK_SIZE) {
+        // oversized fields get their own block, the current one is abandoned
+        blocks_.push_back(std::make_unique_for_overwrite<char[]>(size));
+        used_ = BLOCK_SIZE;
+        return blocks_.back().get();
+    }
+    if (used_ + size > BLOCK_SIZE) {
+        blocks_.push_back(std::make_unique_for_overwrite<char[]>(BLOCK_SIZE));
+        used_ = 0;
+    }
+    char* block = blocks_.back().get() + used_;
+    used_ += size;
+    return block;
+}
+
+void CsvChunk::clear() {
+    fields.clear();
+    rowStarts.clear();
+}
+
+std::size_t CsvChunk::rowCount() const {
+    return rowStarts.size();
+}
+
+std::span<const std::string_view> CsvChunk::row(std::size_t index) const {
+    const std::size_t end = index + 1 < rowStarts.size() ? rowStarts[index + 1] : fields.size();
+    return std::span<const std::string_view>(fields).subspan(rowStarts[index], end - rowStarts[index]);
+}
+
+CsvReader::CsvReader(Logger& cLogger) : logger_(cLogger) {}
+
+bool CsvReader::open(const std::filesystem::path& path) {
+    if (!file_.open(path)) {
+        logger_.pushLog(Log{std::format("ERROR: Failed to open CSV file: {}", path.string())});
+        failed_ = true;
+        return false;
+    }
+    openBuffer(file_.view());
+    return true;
+}
+
+void CsvReader::openBuffer(std::string_view buffer) {
+    data_ = buffer;
+    pos_ = data_.starts_with(UTF8_BOM) ? UTF8_BOM.size() : 0;
+    rowsRead_ = 0;
+    failed_ = false;
+}
+
+std::string_view CsvReader::makeField(std::size_t start, std::size_t end) {
+    const std::string_view raw = data_.substr(start, end - start);
+    const std::size_t firstQuote = raw.find('"');
+    if (firstQuote == std::string_view::npos) { return raw; }
+    // "plain" is the common case and stays a view
+    if (firstQuote == 0 && raw.size() >= 2 && raw.back() == '"' && raw.substr(1, raw.size() - 2).find('"') == std::string_view::npos) {
+        return raw.substr(1, raw.size() - 2);
+    }
+
+    char* out = arena_.allocate(raw.size());
+    std::size_t length = 0;
+    bool quoted = false;
+    for (std::size_t i = 0; i < raw.size(); ++i) {
+        if (raw[i] != '"') {
+            out[length++] = raw[i];
+        } else if (quoted && i + 1 < raw.size() && raw[i + 1] == '"') {
+            out[length++] = '"'; // "" -> "
+            ++i;
+        } else {
+            quoted = !quoted;
+        }
+    }
+    return std::string_view{out, length};
+}
+
+std::size_t CsvReader::lineOf(std::size_t position) const {
+    return 1 + static_cast<std::size_t>(std::count(data_.begin(), data_.begin() + position, '\n'));
+}
+
+bool CsvReader::nextChunk(CsvChunk& chunk, std::size_t maxRows) {
+    chunk.clear();
+    chunk.firstRow = rowsRead_;
+    if (failed_ || pos_ >= data_.size()) { return false; }
+
+    const auto classify = scanMode_ == CsvScanMode::SCALAR ? &CsvScan::classifyScalar : &CsvScan::classify;
+    std::size_t fieldStart = pos_;
+    bool recordOpen = false;
+    uint64_t carry = 0;
+    std::array<char, CSV_BLOCK_SIZE> tail;
+
+    // every call starts on a record boundary, so outside of quotes
+    for (std::size_t blockStart = pos_; blockStart < data_.size(); blockStart += CSV_BLOCK_SIZE) {
+        const char* block = data_.data() + blockStart;
+        if (data_.size() - blockStart < CSV_BLOCK_SIZE) {
+            tail.fill('\0');
+            std::memcpy(tail.data(), block, data_.size() - blockStart);
+            block = tail.data();
+        }
+        const CsvBlockMasks masks = classify(block);
+        uint64_t structurals = (masks.separators | masks.recordEnds) & ~CsvScan::insideQuotes(masks.quotes, carry);
+
+        while (structurals != 0) {
+            const std::size_t at = blockStart + static_cast<std::size_t>(std::countr_zero(structurals));
+            structurals &= structurals - 1;
+            const bool recordEnd = data_[at] != ',';
+
+            if (!recordOpen) {
+                // empty lines and the LF of CRLF carry no record
+                if (recordEnd && at == fieldStart) {
+                    fieldStart = at + 1;
+                    continue;
+                }
+                chunk.rowStarts.push_back(chunk.fields.size());
+                recordOpen = true;
+            }
+            chunk.fields.push_back(makeField(fieldStart, at));
+            fieldStart = at + 1;
+            if (!recordEnd) { continue; }
+
+            recordOpen = false;
+            ++rowsRead_;
+            if (chunk.rowCount() == maxRows) {
+                pos_ = fieldStart;
+                return true;
+            }
+        }
+    }
+
+    if (carry != 0) {
+        logger_.pushLog(Log{std::format("ERROR: CSV parsing failed: Quoted field on line {} is never closed.", lineOf(fieldStart))});
+        failed_ = true;
+        return false;
+    }
+    // last record without a line break
+    if (recordOpen || fieldStart < data_.size()) {
+        if (!recordOpen) { chunk.rowStarts.push_back(chunk.fields.size()); }
+        chunk.fields.push_back(makeField(fieldStart, data_.size()));
+        ++rowsRead_;
+    }
+    pos_ = data_.size();
+    return chunk.rowCount() > 0;
+}
+
+bool CsvReader::failed() const {
+    return failed_;
+}
+
+std::size_t CsvReader::getSize() const {
+    return data_.size();
+}
+
+void CsvReader::setScanMode(CsvScanMode mode) {
+    scanMode_ = mode;
+}
@@ -0,0 +1,53 @@
+#include "csvScanner.hpp"
+
+#ifdef CSV_SCAN_SSE2
+#include <emmintrin.h>
+#endif
+
+CsvBlockMasks CsvScan::classifyScalar(const char* block) {
+    CsvBlockMasks masks{0, 0, 0};
+    for (std::size_t i = 0; i < CSV_BLOCK_SIZE; ++i) {
+        const uint64_t bit = uint64_t{1} << i;
+        switch (block[i]) {
+        case '"':
+            masks.quotes |= bit;
+            break;
+        case ',':
+            masks.separators |= bit;
+            break;
+        case '\n':
+        case '\r':
+            masks.recordEnds |= bit;
+            break;
+        default:
+            break;
+        }
+    }
+    return masks;
+}
+
+#ifdef CSV_SCAN_SSE2
+CsvBlockMasks CsvScan::classify(const char* block) {
+    // sse2 is part of every x86-64 target, no dispatch needed
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i separator = _mm_set1_epi8(',');
+    const __m128i lineFeed = _mm_set1_epi8('\n');
+    const __m128i carriageReturn = _mm_set1_epi8('\r');
+
+    CsvBlockMasks masks{0, 0, 0};
+    for (std::size_t i = 0; i < CSV_BLOCK_SIZE / 16; ++i) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+        const auto toMask = [&](__m128i matches) {
+            return static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(matches))) << (16 * i);
+        };
+        masks.quotes |= toMask(_mm_cmpeq_epi8(bytes, quote));
+        masks.separators |= toMask(_mm_cmpeq_epi8(bytes, separator));
+        masks.recordEnds |= toMask(_mm_or_si128(_mm_cmpeq_epi8(bytes, lineFeed), _mm_cmpeq_epi8(bytes, carriageReturn)));
+    }
+    return masks;
+}
+#else
+CsvBlockMasks CsvScan::classify(const char* block) {
+    return classifyScalar(block);
+}
+#endif
@@ -1,4 +1,5 @@
 #include "dbFilter.hpp"
+#include "metrics.hpp"
 
 std::shared_ptr<const CompleteDbData> DbFilter::filterByKeyword(const std::string& keyword, float similarityThreshhold) {
     similarityThreshhold = std::min(std::max(0.0f, similarityThreshhold), 1.0f);
@@ -6,6 +7,8 @@ std::shared_ptr<const CompleteDbData> DbFilter::filterByKeyword(const std::strin
     if (keyword.empty()) { return std::make_shared<CompleteDbData>(dbData); }
     if (dataStates_.dbData != UI::DataState::DATA_READY) { return std::make_shared<CompleteDbData>(dbData); }
     std::lock_guard<std::mutex> lg(filterMtx_);
+    TraceSpan span{logger_, TraceEvent::FILTER};
+    METRIC_TIMER("filter.filterByKeyword");
     logger_.pushLog(Log{std::format("FILTERING BY {}", keyword)});
 
     dbData.tables = dbData_->tables;
@@ -126,7 +129,7 @@ bool DbFilter::isHit(const std::string& value, const std::string& keyword, float
     }
 
     float ngramDiff = DbFilter::ngramDifference(valueNgram, keywordNgram);
-    if (ngramDiff > 0) { logger_.pushLog(Log{std::format("DATA {} WITH SIMILARITY: {}", value, ngramDiff)}); }
+    if (ngramDiff > 0) { logger_.log<LogLevel::TRACE>("DATA {} WITH SIMILARITY: {}", value, ngramDiff); }
     return ngramDiff > similarityThreshhold;
 }
 
@@ -153,17 +156,22 @@ void DbFilter::setData(std::shared_ptr<const CompleteDbData> newData) {
 }
 
 bool DbFilter::dataReady() const {
-    if (fFilteredData_.valid() && fFilteredData_.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) { return true; }
-    return false;
+    return filteredReady_.load(std::memory_order_acquire);
 }
 
 std::shared_ptr<const CompleteDbData> DbFilter::getFilteredData() {
-    std::shared_ptr<const CompleteDbData> data;
-    if (!dataReady()) { return data; }
-    data = fFilteredData_.get();
-    return data;
+    if (!filteredReady_.exchange(false, std::memory_order_acq_rel)) { return nullptr; }
+    std::lock_guard<std::mutex> lg(resultMtx_);
+    return std::move(filteredData_);
 }
 
 void DbFilter::startFilterSearch(const std::string keyword, float similarityThreshhold) {
-    fFilteredData_ = pool_.submit(&DbFilter::filterByKeyword, this, keyword, similarityThreshhold);
+    const std::size_t generation = ++filterGeneration_;
+    pool_.spawn(TaskLane::CPU, TaskPriority::HIGH, &DbFilter::filterByKeyword, this, keyword, similarityThreshhold)
+        .then(TaskLane::CPU, TaskPriority::HIGH, [this, generation](std::shared_ptr<const CompleteDbData> data) {
+            std::lock_guard<std::mutex> lg(resultMtx_);
+            if (generation != filterGeneration_.load()) { return; } // a newer search is running
+            filteredData_ = std::move(data);
+            filteredReady_.store(true, std::memory_order_release);
+        });
 }
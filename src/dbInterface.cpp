@@ -1,4 +1,5 @@
 #include "dbInterface.hpp"
+#include "metrics.hpp"
 
 TransactionData DbInterface::getTransaction() {
     std::unique_lock lock(connData_.mtx);
@@ -17,7 +18,7 @@ void DbInterface::initializeWithConfigString(const std::string& confString) {
     connData_.cv.notify_all(); // wake all waiting DB threads
 }
 
-void DbInterface::acquireTables() {
+bool DbInterface::acquireTables() {
     try {
         TransactionData transaction = getTransaction();
         const std::string tableQuery = "SELECT table_name FROM information_schema.tables WHERE table_schema='public'";
@@ -36,8 +37,9 @@ void DbInterface::acquireTables() {
         tables_.cv.notify_one();
     } catch (std::exception const& e) {
         logger_.pushLog(Log{std::format("ERROR: {}", e.what())});
-        return;
+        return false;
     }
+    return true;
 }
 
 HeadersInfo DbInterface::getTableHeaders(const std::string& table) {
@@ -159,7 +161,10 @@ HeadersInfo DbInterface::getHeaderInfo(const std::string& table, std::vector<std
 
         pqxx::result typeResult = transaction.tx.exec(typeQuery);
 
-        if (!typeResult.empty()) { info.dataType = DB::toDbType(typeResult[0]["data_type"].c_str()); }
+        if (!typeResult.empty()) {
+            info.sqlType = typeResult[0]["data_type"].c_str();
+            info.dataType = DB::toDbType(info.sqlType);
+        }
 
         headers.data.push_back(info);
     }
@@ -211,11 +216,14 @@ void DbInterface::assignDependencyIndexes() {
     }
 }
 
-void DbInterface::acquireTableContent() {
+bool DbInterface::acquireTableContent() {
     {
-        std::unique_lock<std::mutex> lockTable(tables_.mtx);
-        // logger.pushLog(Log{"ACQUIRE TABLE CONTENT: Waiting for tables"});
-        tables_.cv.wait(lockTable, [this] { return tables_.ready; });
+        // the caller sequences the stages, parking a worker here until acquireTables ran would only block the pool
+        std::lock_guard<std::mutex> lockTable(tables_.mtx);
+        if (!tables_.ready) {
+            logger_.pushLog(Log{"ERROR: Acquiring table content: Tables were not acquired."});
+            return false;
+        }
     }
     {
         std::lock_guard<std::mutex> lgHeaders{tableHeaders_.mtx};
@@ -234,7 +242,7 @@ void DbInterface::acquireTableContent() {
             }
         } catch (std::exception const& e) {
             logger_.pushLog(Log{std::format("ERROR: {}", e.what())});
-            return;
+            return false;
         }
     }
     {
@@ -245,14 +253,10 @@ void DbInterface::acquireTableContent() {
         tables_.ready = false;
     }
     tableHeaders_.cv.notify_one();
+    return true;
 }
 
 void DbInterface::acquireTableRows(const std::string& table, const HeadersInfo& cols) {
-    {
-        // logger.pushLog(Log{"ACQUIRE TABLE ROWS: Waiting for tableheaders"});
-        std::unique_lock<std::mutex> lockTableHeaders(tableHeaders_.mtx);
-        tableHeaders_.cv.wait(lockTableHeaders, [this] { return tableHeaders_.ready; });
-    }
     {
         std::lock_guard<std::mutex> lgTables{tables_.mtx};
         if (std::find(tables_.data.begin(), tables_.data.end(), table) == tables_.data.end()) {
@@ -261,6 +265,7 @@ void DbInterface::acquireTableRows(const std::string& table, const HeadersInfo&
         }
     }
     std::map<std::string, std::vector<std::string>> colCellMap;
+    std::map<std::string, std::vector<bool>> colNullMap;
     // logger.pushLog(Log{"ACQUIRE TABLE ROWS: Preparing headerqueries"});
 
     std::lock_guard<std::mutex> lgTableHeaders(tableHeaders_.mtx);
@@ -280,11 +285,20 @@ void DbInterface::acquireTableRows(const std::string& table, const HeadersInfo&
 
             std::vector<std::string> cells;
             cells.reserve(static_cast<std::size_t>(r.columns()));
+            std::vector<bool> nulls;
 
             for (const pqxx::row& row : r) {
                 cells.emplace_back(row[col.name].c_str());
+                if (row[col.name].is_null()) {
+                    nulls.resize(cells.size());
+                    nulls.back() = true;
+                }
                 // logger.pushLog(Log{std::format("        {}: {}", col.name, row[col.name].c_str())});
             }
+            if (!nulls.empty()) {
+                nulls.resize(cells.size());
+                colNullMap.emplace(col.name, std::move(nulls));
+            }
             colCellMap.emplace(col.name, cells);
 
         } catch (std::exception const& e) {
@@ -295,15 +309,19 @@ void DbInterface::acquireTableRows(const std::string& table, const HeadersInfo&
     {
         std::lock_guard<std::mutex> lgTableRows{tableRows_.mtx};
         tableRows_.data.insert_or_assign(table, std::move(colCellMap));
+        tableNulls_.insert_or_assign(table, std::move(colNullMap));
         tableRows_.ready = true;
     }
 }
 
-CompleteDbData DbInterface::acquireAllTablesRows() {
-    // logger.pushLog(Log{"ACQUIRE ALL TABLE ROWS: Waiting for tableheaders"});
+std::optional<CompleteDbData> DbInterface::acquireAllTablesRows() {
+    METRIC_TIMER("db.acquireAllTablesRows");
     {
-        std::unique_lock<std::mutex> lock(tableHeaders_.mtx);
-        tableHeaders_.cv.wait(lock, [this] { return tableHeaders_.ready; });
+        std::lock_guard<std::mutex> lock(tableHeaders_.mtx);
+        if (!tableHeaders_.ready) {
+            logger_.pushLog(Log{"ERROR: Acquiring rows: Table headers were not acquired."});
+            return std::nullopt;
+        }
     }
 
     std::vector<std::pair<std::string, HeadersInfo>> work;
@@ -318,18 +336,44 @@ CompleteDbData DbInterface::acquireAllTablesRows() {
     for (const auto& [table, headers] : work) {
         acquireTableRows(table, headers);
     }
-    return CompleteDbData{tables_.data, tableHeaders_.data, tableRows_.data, std::map<std::string, std::size_t>{}};
+    return CompleteDbData{tables_.data, tableHeaders_.data, tableRows_.data, std::map<std::string, std::size_t>{}, tableNulls_};
 }
 
-Change::chHashV DbInterface::applyChanges(std::vector<Change> changes, SqlAction action) {
-    Change::chHashV successfulChanges;
+AppliedChanges DbInterface::applyChanges(std::vector<Change> changes, SqlAction action) {
+    METRIC_TIMER("db.applyChanges");
+    AppliedChanges applied;
     for (const auto& change : changes) {
-        if (applySingleChange(change, action)) { successfulChanges.push_back(change.getKey()); }
+        if (applySingleChange(change, action, applied)) { applied.keys.push_back(change.getKey()); }
+    }
+    METRIC_COUNT("db.changesApplied", applied.keys.size());
+    METRIC_COUNT("db.changesFailed", changes.size() - applied.keys.size());
+    METRIC_COUNT("db.changesConflicting", applied.conflicts.size());
+    return applied;
+}
+
+std::vector<std::size_t> DbInterface::reserveIds(const std::string& table, const std::string& pkey, std::size_t count) {
+    METRIC_TIMER("db.reserveIds");
+    std::vector<std::size_t> ids;
+    try {
+        TransactionData transaction = getTransaction();
+        pqxx::params p;
+        p.append(table);
+        p.append(pkey);
+        p.append(static_cast<int64_t>(count));
+        pqxx::result r = transaction.tx.exec("SELECT nextval(pg_get_serial_sequence($1, $2)) FROM generate_series(1, $3)", p);
+        transaction.tx.commit();
+        ids.reserve(r.size());
+        for (const auto& row : r) {
+            ids.push_back(row[0].as<std::size_t>());
+        }
+    } catch (std::exception const& e) {
+        logger_.pushLog(Log{std::format("ERROR: Could not reserve ids for {}: {}", table, e.what())});
+        ids.clear();
     }
-    return successfulChanges;
+    return ids;
 }
 
-bool DbInterface::applySingleChange(const Change& change, SqlAction action) {
+bool DbInterface::applySingleChange(const Change& change, SqlAction action, AppliedChanges& applied) {
     try {
         SqlQuery changeQuery = change.toSQLaction(action);
         logger_.pushLog(Log{std::format("    Applying change {}", change.getKey())});
@@ -340,8 +384,26 @@ bool DbInterface::applySingleChange(const Change& change, SqlAction action) {
             p.append(v);
         }
         pqxx::result r = transaction.tx.exec(changeQuery.query, p);
+        if (change.hasExpectedCells() && r.affected_rows() == 0) {
+            // the transaction is dropped without commit
+            logger_.pushLog(Log{std::format("WARNING: Change {} conflicts, row {} of {} was changed or removed since it was loaded.",
+                                            change.getKey(),
+                                            change.getRowId(),
+                                            change.getTable())});
+            applied.conflicts.push_back(change.getKey());
+            return false;
+        }
         transaction.tx.commit();
         logger_.pushLog(Log{std::format("SUCCESS: Affected rows: {}", r.affected_rows())});
+        if (change.getType() == ChangeType::INSERT_ROW && r.size() == 1) {
+            const std::size_t rowId = r[0][0].as<std::size_t>();
+            if (change.hasReservedRowId() && rowId != change.getRowId()) {
+                logger_.pushLog(
+                    Log{std::format("WARNING: Change {} reserved id {} but was inserted as {}.", change.getKey(), change.getRowId(), rowId)});
+            }
+            std::size_t& maxRowId = applied.maxRowIds[change.getTable()];
+            maxRowId = std::max(maxRowId, rowId);
+        }
     } catch (std::exception const& e) {
         logger_.pushLog(Log{std::format("ERROR: {}", e.what())});
         return false;
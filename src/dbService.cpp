@@ -1,48 +1,85 @@
 #include "dbService.hpp"
+#include "metrics.hpp"
 
 bool DbService::isDataReady() {
-    if (!pendingData_ && fCompleteDbData_.valid() && fCompleteDbData_.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) {
-        auto data = fCompleteDbData_.get();
-        if (!validateCompleteDbData(data)) { return false; }
-        pendingData_ = std::make_unique<CompleteDbData>(std::move(data));
-        fMaxPKeys_ = pool_.submit(&DbService::calcMaxPKeys, this, std::cref(*pendingData_));
+    if (!dataAvailable_.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lg(publishMtx_);
+        if (publishedData_) {
+            // readers off the ui thread pinned the previous pair through getSnapshot, it lives on until they are done
+            std::lock_guard<std::mutex> lgSnapshot(snapshotMtx_);
+            dbData_ = std::move(publishedData_);
+            keys_ = std::move(publishedKeys_);
+            dataAvailable_.store(true, std::memory_order_release);
+        }
     }
+    return dataAvailable_.load(std::memory_order_acquire);
+}
+
+Task<void> DbService::loadData(bool withStructure) {
+    // load -> validate -> calcMaxPKeys run back to back on the workers, only the finished snapshot gets published
+    const std::size_t generation = ++loadGeneration_;
+    TraceSpan span{logger_, TraceEvent::DB_LOAD};
+    try {
+        co_await pool_.schedule(TaskLane::IO, TaskPriority::NORMAL);
+        if (withStructure) {
+            if (!dbInterface_.acquireTables() || !dbInterface_.acquireTableContent()) { co_return; }
+        }
+        std::optional<CompleteDbData> data = dbInterface_.acquireAllTablesRows();
+        if (!data) { co_return; }
 
-    if (pendingData_ && fMaxPKeys_.valid() && fMaxPKeys_.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) {
-        pendingData_->maxPKeys = fMaxPKeys_.get();
-        dbData_ = std::move(pendingData_);
-        dataAvailable_ = true;
+        co_await pool_.schedule(TaskLane::CPU, TaskPriority::HIGH);
+        if (!validateCompleteDbData(*data)) { co_return; }
+        // reserved ids come from the sequences, nothing needs the highest existing key then
+        if (!config_.getReserveIds()) { data->maxPKeys = calcMaxPKeys(*data); }
+        publishData(std::make_shared<const CompleteDbData>(std::move(*data)), generation);
+    } catch (std::exception const& e) {
+        // the ui drops the task, it has to fail like a load the database refused
+        logger_.pushLog(Log{std::format("ERROR: Loading the database failed: {}", e.what())});
     }
+}
 
-    return dataAvailable_;
+void DbService::publishData(std::shared_ptr<const CompleteDbData> data, std::size_t generation) {
+    auto keys = std::make_shared<const SnapshotKeys>(calcKeys(*data)); // still on the loading thread
+    std::lock_guard<std::mutex> lg(publishMtx_);
+    if (generation != loadGeneration_.load()) { return; } // a newer refetch superseded this one
+    publishedData_ = std::move(data);
+    publishedKeys_ = std::move(keys);
 }
 
 DbService::DbService(DbInterface& cDbData, ThreadPool& cPool, Config& cConfig, Logger& cLogger)
     : dbInterface_(cDbData), pool_(cPool), config_(cConfig), logger_(cLogger) {}
 
-void DbService::startUp() {
-    pendingData_.reset();
+Task<void> DbService::startUp() {
     dataAvailable_.store(false, std::memory_order_release);
-    pool_.submit(&DbInterface::acquireTables, &dbInterface_);
-    pool_.submit(&DbInterface::acquireTableContent, &dbInterface_);
-    fCompleteDbData_ = pool_.submit(&DbInterface::acquireAllTablesRows, &dbInterface_);
+    return loadData(true);
 }
 
-void DbService::refetch() {
-    pendingData_.reset();
+Task<void> DbService::refetch() {
     dataAvailable_.store(false, std::memory_order_release);
-    fCompleteDbData_ = pool_.submit(&DbInterface::acquireAllTablesRows, &dbInterface_);
+    return loadData(false);
+}
+
+void DbService::injectData(std::shared_ptr<const CompleteDbData> data) {
+    dataAvailable_.store(false, std::memory_order_release);
+    publishData(std::move(data), ++loadGeneration_);
 }
 
 std::expected<std::shared_ptr<const CompleteDbData>, bool> DbService::getCompleteData() {
     if (isDataReady()) {
+        std::lock_guard<std::mutex> lg(snapshotMtx_);
         return dbData_;
     } else {
         return std::unexpected(false);
     }
 }
 
+DbSnapshot DbService::getSnapshot() const {
+    std::lock_guard<std::mutex> lg(snapshotMtx_);
+    return DbSnapshot{dbData_, keys_, config_, logger_};
+}
+
 std::map<std::string, std::size_t> DbService::calcMaxPKeys(const CompleteDbData& data) const {
+    METRIC_TIMER("dbService.calcMaxPKeys");
     std::map<std::string, std::size_t> maxPKeys;
     for (const auto& table : data.tables) {
         // Get max index of pkeys
@@ -57,26 +94,57 @@ std::map<std::string, std::size_t> DbService::calcMaxPKeys(const CompleteDbData&
     return maxPKeys;
 }
 
-IndexPKeyPair DbService::findIndexAndPKeyOfExisting(const std::string& table, const Change::colValMap& cells) const {
+SnapshotKeys DbService::calcKeys(const CompleteDbData& data) const {
+    METRIC_TIMER("dbService.calcKeys");
+    SnapshotKeys keys;
+    for (const auto& table : data.tables) {
+        const HeadersInfo& headers = data.headers.at(table);
+        const ColumnDataMap& columns = data.tableRows.at(table);
+
+        auto& uKeys = keys.uKeys[table];
+        if (const auto uKeyColumn = columns.find(headers.uKeyName); uKeyColumn != columns.end()) {
+            uKeys.reserve(uKeyColumn->second.size());
+            for (std::size_t i = 0; i < uKeyColumn->second.size(); ++i) {
+                uKeys.try_emplace(uKeyColumn->second[i], i); // the first row wins, like a scan would find it
+            }
+        }
+        const StringVector& pKeyColumn = columns.at(headers.pkey);
+        auto& pKeys = keys.pKeys[table];
+        pKeys.reserve(pKeyColumn.size());
+        for (std::size_t i = 0; i < pKeyColumn.size(); ++i) {
+            pKeys.try_emplace(pKeyColumn[i], i);
+        }
+    }
+    return keys;
+}
+
+IndexPKeyPair DbSnapshot::findIndexAndPKeyOfExisting(const std::string& table, const Change::colValMap& cells) const {
     const HeadersInfo& headers = dbData_->headers.at(table);
     const std::string& uKeyName = headers.uKeyName;
-    const ColumnDataMap& row = dbData_->tableRows.at(table);
-    const StringVector& uKeyColumn = row.at(uKeyName);
+    const auto& uKeys = keys_->uKeys.at(table);
     IndexPKeyPair result{INVALID_ID, INVALID_ID};
 
-    if (!cells.contains(uKeyName)) { return result; }
+    const auto cell = cells.find(uKeyName);
+    if (cell == cells.end()) { return result; }
 
-    auto itExisting = std::find(uKeyColumn.begin(), uKeyColumn.end(), cells.at(uKeyName));
-    if (itExisting != uKeyColumn.end()) {
-        logger_.pushLog(Log{std::format("INFO: Table {} with unique key {}: {} already exists.", table, uKeyName, cells.at(uKeyName))});
-        result.index = itExisting - uKeyColumn.begin();
-        const std::string& rowId = row.at(headers.pkey).at(result.index);
+    const auto itExisting = uKeys.find(cell->second);
+    if (itExisting != uKeys.end()) {
+        logger_.pushLog(Log{std::format("INFO: Table {} with unique key {}: {} already exists.", table, uKeyName, cell->second)});
+        result.index = itExisting->second;
+        const std::string& rowId = dbData_->tableRows.at(table).at(headers.pkey).at(result.index);
         result.pkey = static_cast<std::size_t>(std::stoi(rowId));
     }
     return result;
 }
 
-bool DbService::hasQuantityColumn(const std::string& table) const {
+std::size_t DbSnapshot::findIndexOfPKey(const std::string& table, std::string_view pkey) const {
+    const auto pKeys = keys_->pKeys.find(table);
+    if (pKeys == keys_->pKeys.end()) { return INVALID_ID; }
+    const auto row = pKeys->second.find(pkey);
+    return row != pKeys->second.end() ? row->second : INVALID_ID;
+}
+
+bool DbSnapshot::hasQuantityColumn(const std::string& table) const {
     const HeadersInfo& headers = dbData_->headers.at(table);
     const std::string& quantityColumn = config_.getQuantityColumn();
     auto itHasQuantityHeader =
@@ -84,7 +152,7 @@ bool DbService::hasQuantityColumn(const std::string& table) const {
     return itHasQuantityHeader != headers.data.end();
 }
 
-void DbService::updateChangeQuantity(const std::string& table,
+void DbSnapshot::updateChangeQuantity(const std::string& table,
                                      Change::colValMap& cells,
                                      const std::size_t index,
                                      DB::QuantityOperation operation) const {
@@ -142,6 +210,43 @@ void DbService::updateChangeQuantity(const std::string& table,
     }
 }
 
+void DbSnapshot::captureExpectedCells(Change& change, const std::size_t index) const {
+    if (!config_.getCheckConflicts() || index == INVALID_ID) { return; }
+    const std::string& table = change.getTable();
+    const ColumnDataMap& columns = dbData_->tableRows.at(table);
+    const HeadersInfo& headers = dbData_->headers.at(table);
+    const auto nulls = dbData_->nullCells.find(table);
+    Change::expCellMap expected;
+    const auto expect = [&](const std::string& column, const StringVector& cells) {
+        if (index >= cells.size()) { return; }
+        ExpectedCell& cell = expected[column];
+        const auto header = std::ranges::find(headers.data, column, &HeaderInfo::name);
+        if (header != headers.data.end()) { cell.type = header->sqlType; }
+        if (nulls != dbData_->nullCells.end()) {
+            const auto columnNulls = nulls->second.find(column);
+            if (columnNulls != nulls->second.end() && columnNulls->second[index]) { return; }
+        }
+        cell.value = cells[index];
+    };
+    switch (change.getType()) {
+    case ChangeType::UPDATE_CELLS:
+        for (const auto& [column, value] : change.getCells()) {
+            const auto cells = columns.find(column);
+            if (cells != columns.end()) { expect(cells->first, cells->second); }
+        }
+        break;
+    case ChangeType::DELETE_ROW:
+        // a row somebody else edited in the meantime is not the one that was meant to go
+        for (const auto& [column, cells] : columns) {
+            if (column != headers.pkey) { expect(column, cells); }
+        }
+        break;
+    default:
+        return;
+    }
+    change.setExpectedCells(std::move(expected));
+}
+
 bool DbService::validateCompleteDbData(const CompleteDbData& data) const {
     // tablecount matches everywhere
     std::size_t tableCount = data.tables.size();
@@ -172,7 +277,8 @@ bool DbService::validateCompleteDbData(const CompleteDbData& data) const {
     return true;
 }
 
-bool DbService::validateChange(Change& change, bool fromGeneration) const {
+bool DbSnapshot::validateChange(Change& change, bool fromGeneration) const {
+    METRIC_TIMER("dbService.validateChange");
     const StringVector& tables = dbData_->tables;
     auto it = std::find(tables.begin(), tables.end(), change.getTable());
     if (it == tables.end()) { return false; }
@@ -239,7 +345,8 @@ bool DbService::validateChange(Change& change, bool fromGeneration) const {
     return true;
 }
 
-std::vector<Change> DbService::getRequiredChanges(const Change& change, const std::map<std::string, std::size_t>& ids) const {
+std::vector<Change> DbSnapshot::getRequiredChanges(const Change& change, const std::map<std::string, std::size_t>& ids) const {
+    METRIC_TIMER("dbService.getRequiredChanges");
     const std::string& table = change.getTable();
     std::vector<Change> changes;
     const HeadersInfo& headers = dbData_->headers.at(table);
@@ -268,55 +375,69 @@ std::vector<Change> DbService::getRequiredChanges(const Change& change, const st
                 } else {
                     requiredCells.emplace(dbData_->headers.at(it1->referencedTable).uKeyName, val);
                 }
-                Change reqChange{requiredCells, ChangeType::INSERT_ROW, getTable(it1->referencedTable)};
+                Change reqChange{std::move(requiredCells), ChangeType::INSERT_ROW, getTable(it1->referencedTable)};
                 reqChange.addParent(change.getKey());
-                changes.emplace_back(reqChange);
+                changes.push_back(std::move(reqChange));
             }
         }
     }
     return changes;
 }
 
-bool DbService::checkReferencedPKeyValue(const std::string& ref, const std::string& val) const {
+bool DbSnapshot::checkReferencedPKeyValue(const std::string& ref, const std::string& val) const {
     // does pkey-value already exist
     if (val.empty()) { return true; }
-    std::string pKey = dbData_->headers.at(ref).pkey;
-    auto it1 = std::ranges::find_if(dbData_->tableRows.at(ref).at(pKey), [&](const std::string& h) { return h == val; });
-    if (it1 != dbData_->tableRows.at(ref).at(pKey).end()) { return true; }
-    return false;
+    return keys_->pKeys.at(ref).contains(val);
 }
 
-bool DbService::checkReferencedUKeyValue(const std::string& ref, bool nullable, const std::string& val) const {
+bool DbSnapshot::checkReferencedUKeyValue(const std::string& ref, bool nullable, const std::string& val) const {
     // does ukey-value already exist
     if (val.empty() && nullable) { return true; }
-    std::string uKey = dbData_->headers.at(ref).uKeyName;
-    auto it1 = std::ranges::find_if(dbData_->tableRows.at(ref).at(uKey), [&](const std::string& h) { return h == val; });
-    if (it1 != dbData_->tableRows.at(ref).at(uKey).end()) { return true; }
-    return false;
+    return keys_->uKeys.at(ref).contains(val);
 }
 
 void DbService::initializeDbInterface(const std::string& configString) const {
     dbInterface_.initializeWithConfigString(configString);
 }
 
-std::future<Change::chHashV> DbService::requestChangeApplication(std::vector<Change> changes, SqlAction action) const {
-    return pool_.submit(
-        [this](auto change, SqlAction act) { return dbInterface_.applyChanges(std::move(change), act); }, std::move(changes), action);
+Task<AppliedChanges> DbService::requestChangeApplication(std::vector<Change> changes, SqlAction action) const {
+    co_await pool_.schedule(TaskLane::IO, TaskPriority::NORMAL);
+    AppliedChanges applied = dbInterface_.applyChanges(std::move(changes), action);
+    co_await pool_.schedule(TaskLane::CPU, TaskPriority::NORMAL); // callers go on with bookkeeping, keep it off the io lane
+    co_return applied;
+}
+
+bool DbService::reservesIds() const {
+    return config_.getReserveIds();
+}
+
+std::vector<std::size_t> DbService::reserveIds(const std::string& table, std::size_t count) const {
+    return dbInterface_.reserveIds(table, getSnapshot().getTablePKey(table), count);
 }
 
-ImTable DbService::getTable(const std::string& tableName) const {
+ImTable DbSnapshot::getTable(const std::string& tableName) const {
     auto it = std::find(dbData_->tables.begin(), dbData_->tables.end(), tableName);
     ImTable tableData{tableName, 0};
     if (it != dbData_->tables.end()) { tableData.id = static_cast<uint16_t>(std::distance(dbData_->tables.begin(), it)); }
     return tableData;
 }
 
-std::string DbService::getTableUKey(const std::string& table) const {
+std::string DbSnapshot::getTableUKey(const std::string& table) const {
     return dbData_->headers.at(table).uKeyName;
 }
 
-HeaderInfo DbService::getTableHeaderInfo(const std::string& table, const std::string& header) const {
+std::string DbSnapshot::getTablePKey(const std::string& table) const {
+    return dbData_->headers.at(table).pkey;
+}
+
+HeaderInfo DbSnapshot::getTableHeaderInfo(const std::string& table, const std::string& header) const {
     const HeaderVector& headers = dbData_->headers.at(table).data;
     auto it = std::find_if(headers.begin(), headers.end(), [&](const HeaderInfo& h) { return h.name == header; });
     return *it;
 }
+
+bool DbSnapshot::hasColumn(const std::string& table, std::string_view column) const {
+    const auto it = dbData_->headers.find(table);
+    if (it == dbData_->headers.end()) { return false; }
+    return std::ranges::any_of(it->second.data, [&](const HeaderInfo& h) { return h.name == column; });
+}
@@ -0,0 +1,164 @@
+// Headless import of a BOM or order csv with the mappings the ui saved (Config::readMappings), for scheduled bulk imports.
+// Usage: InventoryImport <bom|order> <csv> [--config path] [--preview] [--execute] [--metrics path]
+// Without --execute the changes are only generated and summarized, --preview prints their sql.
+
+#include "autoGenInfo.hpp"
+#include "autoInv.hpp"
+#include "changeExeService.hpp"
+#include "changeTracker.hpp"
+#include "config.hpp"
+#include "dbInterface.hpp"
+#include "dbService.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include "partApi.hpp"
+#include "threadPool.hpp"
+
+#include <iostream>
+#include <string_view>
+
+namespace {
+struct ImportOptions {
+    bool bom = true;
+    std::filesystem::path csv;
+    std::filesystem::path config;
+    std::filesystem::path metrics;
+    bool preview = false;
+    bool execute = false;
+};
+
+std::optional<ImportOptions> parseArguments(int argc, char** argv) {
+    if (argc < 3) { return std::nullopt; }
+    ImportOptions options;
+    const std::string_view kind = argv[1];
+    if (kind != "bom" && kind != "order") { return std::nullopt; }
+    options.bom = kind == "bom";
+    options.csv = argv[2];
+    for (int i = 3; i < argc; ++i) {
+        const std::string_view argument = argv[i];
+        if (argument == "--preview") {
+            options.preview = true;
+        } else if (argument == "--execute") {
+            options.execute = true;
+        } else if (argument == "--config" && i + 1 < argc) {
+            options.config = argv[++i];
+        } else if (argument == "--metrics" && i + 1 < argc) {
+            options.metrics = argv[++i];
+        } else {
+            return std::nullopt;
+        }
+    }
+    return options;
+}
+
+const char* changeTypeName(ChangeType type) {
+    switch (type) {
+    case ChangeType::INSERT_ROW:
+        return "insert";
+    case ChangeType::UPDATE_CELLS:
+        return "update";
+    case ChangeType::DELETE_ROW:
+        return "delete";
+    default:
+        return "none";
+    }
+}
+
+void printSummary(const uiChangeInfo& changes, std::size_t rows) {
+    std::map<std::string, std::map<ChangeType, std::size_t>> perTable;
+    std::size_t invalid = 0;
+    for (const auto& [table, tableChanges] : changes.tables) {
+        for (const auto& [key, change] : tableChanges->changes) {
+            perTable[table][change.getType()]++;
+            if (!change.isValid()) { invalid++; }
+        }
+    }
+    std::string out = std::format("Imported {} csv rows into {} changes ({} invalid):\n", rows, changes.changeCount(), invalid);
+    for (const auto& [table, types] : perTable) {
+        out += std::format("    {}:", table);
+        for (const auto& [type, count] : types) {
+            out += std::format(" {} {}", count, changeTypeName(type));
+        }
+        out += '\n';
+    }
+    std::cout << out;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::optional<ImportOptions> options = parseArguments(argc, argv);
+    if (!options) {
+        std::cerr << "Usage: InventoryImport <bom|order> <csv> [--config path] [--preview] [--execute] [--metrics path]\n";
+        return 1;
+    }
+
+    Logger logger;
+    Change::setLogger(logger);
+    Config config{logger};
+
+    AutoGenInfo::setConfig(config);
+    AutoGenInfo::setLogger(logger);
+
+    ThreadPool pool{6, 4, logger};
+
+    DbInterface dbInterface{logger};
+    DbService dbService{dbInterface, pool, config, logger};
+    ChangeTracker changeTracker{dbService, logger};
+    ChangeExeService changeExe{dbService, changeTracker, logger};
+    PartApi api{pool, config, logger};
+
+    AutoInv::ChangeGeneratorFromBom bomReader{pool, changeTracker, dbService, api, config, logger};
+    AutoInv::ChangeGeneratorFromOrder orderReader{pool, changeTracker, dbService, api, config, logger};
+    AutoInv::CsvChangeGenerator& reader = options->bom ? static_cast<AutoInv::CsvChangeGenerator&>(bomReader) : orderReader;
+
+    // an empty connection string would park the loading worker forever
+    const std::string dbString = config.setConfigString(options->config);
+    if (dbString.empty()) {
+        logger.pushLog(Log{"ERROR: No database configured."});
+        return 1;
+    }
+    dbService.initializeDbInterface(dbString);
+    dbService.startUp().get();
+    auto data = dbService.getCompleteData();
+    if (!data) {
+        logger.pushLog(Log{"ERROR: Loading the database failed."});
+        return 1;
+    }
+    reader.setData(*data);
+    changeTracker.setMaxPKeys((*data)->maxPKeys);
+
+    AutoInv::LoadedMappings loaded = config.readMappings();
+    std::vector<AutoInv::SerializableMapping>& mappings = options->bom ? loaded.bom : loaded.order;
+    if (mappings.empty()) {
+        logger.pushLog(Log{"ERROR: No saved mappings, map a csv of this kind once in the ui."});
+        return 1;
+    }
+
+    if (!reader.importCsv(options->csv, std::move(mappings)).get()) { return 1; }
+    const std::shared_ptr<const uiChangeInfo> changes = changeTracker.getSnapShot();
+    printSummary(*changes, reader.getDataRowCount());
+
+    if (options->preview) {
+        for (const auto& [table, tableChanges] : changes->tables) {
+            for (const auto& [key, change] : tableChanges->changes) {
+                std::cout << change.toSQLaction(SqlAction::PREVIEW).query << '\n';
+            }
+        }
+    }
+
+    int result = 0;
+    if (options->execute) {
+        changeExe.requestChangeApplication(SqlAction::EXECUTE).get();
+        const std::size_t executed = changeExe.getSuccessfulChanges().size();
+        std::cout << std::format("Executed {} of {} changes.\n", executed, changes->changeCount());
+        const std::size_t conflicting = changeExe.getConflictingChanges().size();
+        if (conflicting != 0) { std::cout << std::format("{} changes conflicted with newer data, import again.\n", conflicting); }
+        if (executed != changes->changeCount()) { result = 2; }
+    }
+
+    config.saveApiArchive();
+    if (!options->metrics.empty() && !Metrics::exportJson(options->metrics)) {
+        logger.pushLog(Log{std::format("ERROR: Could not write metrics to {}.", options->metrics.string())});
+    }
+    return result;
+}
@@ -13,8 +13,8 @@ class AutoGenInfo {
     static inline Logger* logger_ = nullptr;
     static inline Config* config_ = nullptr;
     static inline std::filesystem::path csvPath_;
-    static inline uint16_t changesTotal_;
-    static inline uint16_t addedChanges_;
+    static inline std::size_t changesTotal_; // bulk imports easily pass 65535 lines
+    static inline std::size_t addedChanges_;
     static inline std::unordered_set<std::size_t> unexecutedChangeKeys_;
     static inline DB::QuantityOperation operation_{DB::QuantityOperation::SET};
 
@@ -105,7 +105,7 @@ class AutoGenInfo {
             logger_->pushLog(Log{std::format("ERROR: Could not open archive on path: {}", path.string())});
             return;
         }
-        logger_->pushLog(Log{archiveJson.dump()});
+        if (logger_->isEnabled(LogLevel::DEBUG)) { logger_->pushLog(Log{LogLevel::DEBUG, archiveJson.dump()}); }
         archiveWrite << archiveJson.dump();
 
         changesTotal_ = 0;
@@ -1,12 +1,17 @@
 #pragma once
 
 #include "changeTracker.hpp"
+#include "csvReader.hpp"
 #include "dbService.hpp"
 #include "logger.hpp"
 #include "partApi.hpp"
 #include "threadPool.hpp"
 
-#include <set>
+#include <optional>
+#include <span>
+
+CSV::Data readData(std::filesystem::path csv, Logger& logger);
+bool writeData(std::filesystem::path csv, const CSV::Data& data, Logger& logger);
 
 namespace AutoInv {
 struct TableCells {
@@ -14,24 +19,55 @@ struct TableCells {
     Change::colValMap cells;
 };
 
-struct PreciseMapLocationCombined {
-    // helper for differentiating api and csv
-    PreciseMapLocation locations;
-    SourceType source;
+// Mappings compiled once per import, a row only copies its values into the prepared slots.
+struct MappingPlan {
+    struct Cell {
+        ColumnName column;
+        SourceType source;
+        std::size_t index; // csv column, or api slot of a row in CsvBatch::apiValues
+    };
+    struct Table {
+        std::string name;
+        std::vector<Cell> cells;
+        std::vector<ColumnName> required; // neither nullable, primary key nor mapped, gets a placeholder
+    };
+    std::vector<Table> tables;        // ascending relation depth, the last one decides whether a row is new
+    std::size_t placeholders = 0;     // required columns of all tables, every row numbers its own
+    std::size_t firstPlaceholder = 0; // number of the first placeholder of csv row 1
 };
 
-struct TargetData {
-    std::vector<PreciseMapLocationCombined> dbHeaders;
+// Consecutive csv rows travelling through the import pipeline, picking up their api data and changes on the way.
+struct CsvBatch {
+    std::size_t firstRow = 0;                      // csv row of rows[0], the header is row 0
+    std::vector<std::vector<std::string>> storage; // owns the rows when streaming, moving keeps rows valid
+    std::span<const std::vector<std::string>> rows;
+    std::vector<std::string> apiValues;     // row major, one slot per api mapping
+    std::vector<bool> apiFailed;            // per row
+    std::vector<PreparedSequence> prepared; // per row, empty if the row changes nothing
 };
 
-struct ChangeConvertedMapping {
-    std::vector<std::size_t> columnIndexes;                     // csv columns that actually have a mapping
-    std::unordered_map<std::size_t, TargetData> preciseHeaders; // column-index -> [dbHeaders]
-    std::map<std::string, TableCells> cells;                    // storage for change-cels
-    std::vector<TableCells*> orderedCells;                      // ordered version for optimal change execution
-};
+// Hands out batches of rows that are already in memory, or streams them from a file so the import never holds all of it.
+class CsvBatchSource {
+  private:
+    Logger& logger_;
+    const std::vector<std::vector<std::string>>* loaded_ = nullptr;
+    CsvReader reader_;
+    CsvChunk chunk_;
+    std::vector<std::string> header_;
+    std::size_t nextRow_ = 1;
+    bool failed_ = false;
 
-using ApiResultType = std::vector<std::unordered_map<std::string, Change::colValMap>>;
+  public:
+    explicit CsvBatchSource(Logger& cLogger);
+    CsvBatchSource(Logger& cLogger, const std::vector<std::vector<std::string>>& cRows);
+
+    // streams csv, the header is read right away
+    bool open(const std::filesystem::path& csv);
+    const std::vector<std::string>& getHeader() const;
+    // nullopt once all rows were handed out or a row is malformed
+    std::optional<CsvBatch> next(std::size_t maxRows);
+    bool failed() const;
+};
 
 class CsvChangeGenerator {
   protected:
@@ -47,21 +83,21 @@ class CsvChangeGenerator {
     std::filesystem::path lastSuccessfulCsvPath_;
 
     CSV::Data csvData_;
-    std::future<bool> fRead_;
     std::condition_variable cvRead_;
     std::mutex mtxRead_;
 
-    std::future<void> fExecMappings_;
+    Task<void> execMappings_;
 
-    bool dataRead_ = false;
+    std::atomic<bool> dataRead_{false};
+    std::atomic<bool> readFresh_{false}; // a read finished that dataValid(true) has not reported yet
 
     std::vector<MappingCsvToDb> directMappings_;
     std::vector<MappingCsvToDb> indirectApiMappings_;
     std::vector<MappingCsvApi> intermediateApiMappings_;
     std::size_t missingParam_ = 0;
 
-    std::set<std::size_t> failedCsvApiRows_;
-    std::mutex failedCsvApiMtx_;
+    std::vector<std::vector<std::string>> failedCsvApiRows_;
+    std::size_t rowCount_ = 0;
 
     DB::QuantityOperation operation_;
 
@@ -74,27 +110,28 @@ class CsvChangeGenerator {
                        DB::QuantityOperation cOperation);
     virtual ~CsvChangeGenerator() = default;
 
-    bool run(std::filesystem::path csv);
-    void convertMappings(ChangeConvertedMapping& convertedMapping,
-                         std::unordered_set<std::string>& foundTables,
-                         const std::vector<MappingCsvToDb>& mappings,
-                         SourceType source);
-    ChangeConvertedMapping convertMapping();
+    // reads csv for the mapping ui, column types are inferred in parallel and sampled if the config says so
+    Task<bool> run(std::filesystem::path csv);
+    Task<std::vector<DB::TypeCategory>> inferColumnTypes();
+    MappingPlan compileMappings(const DbSnapshot& db) const;
     const MappingCsvApi& findApiSource(MappingIdType mappingId) const;
     std::string getJsonTarget(const nlohmann::json& j, const std::string& selectedField);
-    void fetchChunk(std::span<std::vector<std::string>> chunk,
-                    std::span<std::unordered_map<std::string, Change::colValMap>> resultChunk,
-                    std::size_t chunkStart);
-    ApiResultType fetchApiData();
-    void applyMappingToRow(const std::vector<std::string>& row,
-                           ChangeConvertedMapping& mapped,
-                           std::unordered_map<std::string, Change::colValMap>& apiData);
-    void fillInAdditional(ChangeConvertedMapping& mapped);
-    void sortMappedCells(ChangeConvertedMapping& mapped);
-    void addChangesFromMapping(ChangeConvertedMapping& mapped);
-    bool processCell(TableCells* cells, bool onlyAddIfFound = false);
-    void executeCsv();
+    CsvBatch enrichBatch(CsvBatch batch);
+    Task<CsvBatch> prepareBatch(CsvBatch batch, const MappingPlan& plan, const DbSnapshot& db);
+    std::vector<PreparedSequence>
+    prepareRows(const CsvBatch& batch, const MappingPlan& plan, const DbSnapshot& db, std::size_t start, std::size_t end) const;
+    void applyPlan(const MappingPlan& plan,
+                   std::span<const std::string> row,
+                   std::span<const std::string> apiValues,
+                   std::size_t placeholder,
+                   std::vector<TableCells>& rowCells) const;
+    PreparedSequence prepareRow(std::vector<TableCells>& rowCells, const DbSnapshot& db) const;
+    PreparedChange prepareCells(TableCells& cells, const IndexPKeyPair& found, const DbSnapshot& db) const;
+    void mergeBatch(CsvBatch& batch, const DbSnapshot& db);
+    Task<bool> runPipeline(CsvBatchSource& source);
+    Task<void> executeCsv();
     void writeBackFailedRows();
+    void storeMappings(const std::vector<SerializableMapping>& mappings);
 
   public:
     std::mutex& getMutexRead();
@@ -107,6 +144,10 @@ class CsvChangeGenerator {
     const std::vector<std::string>& getFirstRow();
     void setMappingsToDb(const std::vector<MappingNumber> mappings);
     void reqExecuteCsv();
+    // read -> saved mappings -> changes without the mapping widgets, false if the csv could not be read
+    Task<bool> importCsv(std::filesystem::path csv, std::vector<SerializableMapping> mappings);
+    // rows the last import went through
+    std::size_t getDataRowCount();
 };
 
 class ChangeGeneratorFromBom : public CsvChangeGenerator {
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Interned column name. Equal names share one string that lives until the program ends, so copies are a pointer and
+// comparing two of them is a pointer comparison.
+class ColumnName {
+  private:
+    const std::string* name_;
+
+    static const std::string* intern(std::string_view name);
+
+  public:
+    ColumnName();
+    explicit ColumnName(std::string_view name);
+
+    const std::string& str() const { return *name_; }
+    operator const std::string&() const { return *name_; }
+
+    bool operator==(const ColumnName& other) const { return name_ == other.name_; }
+    friend bool operator==(const ColumnName& column, std::string_view name) { return *column.name_ == name; }
+};
+
+// Cells of a change ordered by column name. Up to INLINE_CELLS of them live inside the object, which covers every
+// table so far, only wider changes move to the heap.
+class CellMap {
+  public:
+    using Cell = std::pair<ColumnName, std::string>;
+    static constexpr std::size_t INLINE_CELLS = 6;
+
+  private:
+    std::array<Cell, INLINE_CELLS> inline_;
+    std::vector<Cell> spilled_; // all cells once there are more than INLINE_CELLS
+    std::size_t size_ = 0;
+
+    Cell* data() { return spilled_.empty() ? inline_.data() : spilled_.data(); }
+    const Cell* data() const { return spilled_.empty() ? inline_.data() : spilled_.data(); }
+    Cell* lowerBound(std::string_view name);
+    Cell* insertAt(Cell* position, ColumnName column, std::string value);
+
+  public:
+    CellMap() = default;
+    CellMap(const CellMap&) = default;
+    CellMap& operator=(const CellMap&) = default;
+    // leaves other empty, the size alone would point past its inline cells
+    CellMap(CellMap&& other) noexcept;
+    CellMap& operator=(CellMap&& other) noexcept;
+    CellMap(std::initializer_list<std::pair<std::string_view, std::string>> cells);
+
+    std::span<const Cell> cells() const { return {data(), size_}; }
+    const Cell* begin() const { return data(); }
+    const Cell* end() const { return data() + size_; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    Cell* find(std::string_view name);
+    const Cell* find(std::string_view name) const;
+    bool contains(std::string_view name) const { return find(name) != end(); }
+    std::string& at(std::string_view name);
+    const std::string& at(std::string_view name) const;
+
+    // keeps an existing value, like std::map
+    std::pair<Cell*, bool> try_emplace(ColumnName column, std::string value);
+    std::pair<Cell*, bool> try_emplace(std::string_view name, std::string value) { return try_emplace(ColumnName{name}, std::move(value)); }
+    std::pair<Cell*, bool> emplace(ColumnName column, std::string value) { return try_emplace(column, std::move(value)); }
+    std::pair<Cell*, bool> emplace(std::string_view name, std::string value) { return try_emplace(ColumnName{name}, std::move(value)); }
+    void insertOrAssign(ColumnName column, std::string value);
+    bool erase(std::string_view name);
+    void clear();
+};
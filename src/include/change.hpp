@@ -1,10 +1,13 @@
 #pragma once
 
+#include "cellMap.hpp"
 #include "logger.hpp"
 
 #include <atomic>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <unordered_set>
 
 constexpr const std::size_t INVALID_ID = std::numeric_limits<std::size_t>::max();
@@ -22,15 +25,23 @@ struct SqlQuery {
     std::vector<std::string> params;
 };
 
+// A cell as the snapshot showed it. The database compares it in the column's own type, text would read a boolean
+// as true where the snapshot holds t.
+struct ExpectedCell {
+    std::string type;                 // as postgres formats it, empty if unknown
+    std::optional<std::string> value; // nullopt for NULL, which is not the empty string
+};
+
 class Change {
+    friend class ChangeLog; // restores keys and links of logged changes
+
   public:
-    using colValMap = std::map<std::string, std::string>;
+    using colValMap = CellMap;
     template <class T> using chSimpleMap = std::map<T, std::size_t>;
     using chHHMap = chSimpleMap<std::size_t>;
     using chHashV = std::vector<std::size_t>;
     using chHashM = std::map<std::size_t, Change>;
-    using ctPKMD = std::map<std::string, chHHMap>;
-    using ctUKMD = std::map<std::string, chSimpleMap<std::string>>;
+    using expCellMap = std::map<std::string, ExpectedCell>;
 
   private:
     static inline std::atomic<std::size_t> nextId_{1};
@@ -39,10 +50,12 @@ class Change {
     std::size_t changeKey_;
 
     colValMap changedCells_;
+    expCellMap expectedCells_; // the row as the snapshot showed it, updates and deletes only apply while it still is
     ChangeType type_{ChangeType::UPDATE_CELLS};
 
     ImTable tableData_;
     std::optional<uint32_t> rowId_;
+    bool reservedRowId_{false}; // taken from the table's sequence, the insert sends it along
 
     std::vector<std::size_t> parentKeys_;
     std::vector<std::size_t> childrenKeys_;
@@ -51,6 +64,9 @@ class Change {
     bool locallyValid_{false};
     bool valid_{false};
 
+    // one comparison per expected cell, their values are appended to params
+    std::string expectedCondition(std::vector<std::string>& params) const;
+
   public:
     Change(colValMap cCells, ChangeType cType, ImTable cTable, std::optional<std::size_t> cRowId = std::nullopt);
     static void setLogger(Logger& l);
@@ -59,8 +75,12 @@ class Change {
     const std::string& getTable() const;
     bool hasRowId() const;
     uint32_t getRowId() const;
-    colValMap getCells() const;
-    std::string getCell(const std::string& header) const;
+    const colValMap& getCells() const;
+    const std::string& getCell(const std::string& header) const; // empty if the change has no such cell
+    const expCellMap& getExpectedCells() const;
+    bool hasExpectedCells() const;
+    void setExpectedCells(expCellMap cells);
+    void addExpectedCells(const expCellMap& cells); // keeps the earlier expectation of a column
 
     Change(const Change&) = default;
     Change& operator=(const Change&) = default;
@@ -73,6 +93,8 @@ class Change {
     bool isSelected() const;
     void addParent(std::size_t parent);
     void setRowId(uint32_t aRowId);
+    void setReservedRowId(uint32_t aRowId);
+    bool hasReservedRowId() const;
     bool hasParent() const;
     std::size_t getParentCount() const;
     const std::vector<std::size_t>& getParents() const;
@@ -88,12 +110,22 @@ class Change {
     std::string getCellSummary(const uint8_t len) const;
 };
 
-struct uiChangeInfo {
-    Change::ctPKMD idMappedChanges;
+struct uiTableChanges {
+    Change::chHHMap idMappedChanges; // primaryKey -> changeKey
     Change::chHashM changes;
+};
+
+// Immutable view of the pending changes. Tables without changes since the previous version share its data.
+struct uiChangeInfo {
+    std::map<std::string, std::shared_ptr<const uiTableChanges>> tables;
     std::unordered_set<std::size_t> roots;
+    std::size_t version = 0;
+
+    const uiTableChanges* getTable(const std::string& table) const;
+    const Change& getChange(std::size_t key) const;
+    std::size_t changeCount() const;
 };
 
 namespace ChangeHelpers {
-std::unique_ptr<Change> getChangeOfRow(const std::shared_ptr<uiChangeInfo>& uiChanges, const std::string& table, const std::size_t id);
+std::unique_ptr<Change> getChangeOfRow(const std::shared_ptr<const uiChangeInfo>& uiChanges, const std::string& table, const std::size_t id);
 } // namespace ChangeHelpers
\ No newline at end of file
@@ -12,16 +12,21 @@ class ChangeExeService {
     ChangeTracker& changeTracker_;
     Logger& logger_;
 
-    std::future<Change::chHashV> fApplyChanges_;
+    Change::chHashV successfulChanges_;
+    Change::chHashV conflictingChanges_;
+    std::mutex resultMtx_;
+    std::atomic<bool> applicationDone_{false};
 
-    void collectChanges(std::size_t key, std::unordered_set<std::size_t>& visited, std::vector<Change>& order);
-    std::vector<Change> collectDescendants(const std::vector<std::size_t>& roots);
+    Task<void> startApplication(std::vector<Change> changes, SqlAction action);
 
   public:
     ChangeExeService(DbService& cDbService, ChangeTracker& cChangeTracker, Logger& cLogger);
     bool isChangeApplicationDone();
     Change::chHashV getSuccessfulChanges();
-    void requestChangeApplication(std::size_t changeKey, SqlAction action);
-    void requestChangeApplication(const std::vector<std::size_t> changeKeys, SqlAction action);
-    void requestChangeApplication(SqlAction action);
+    // of the last application, they stay pending and have to be redone against a fresh snapshot
+    Change::chHashV getConflictingChanges();
+    // the returned task finishes after the executed changes were removed, the ui polls isChangeApplicationDone instead
+    Task<void> requestChangeApplication(std::size_t changeKey, SqlAction action);
+    Task<void> requestChangeApplication(const std::vector<std::size_t> changeKeys, SqlAction action);
+    Task<void> requestChangeApplication(SqlAction action);
 };
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "change.hpp"
+#include "dbService.hpp"
+#include "flatContainers.hpp"
+#include "logger.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+class ChangeStore;
+
+// Pending changes on disk, so a crash or a restart does not lose them. The file only grows: every tracker operation
+// appends one frame holding the state its changes ended up in, or that they are gone. A frame carries its length and
+// a crc32, the first torn or damaged one ends the replay and gets cut off, so a restart sees the state after the last
+// complete operation. Once the file holds far more records than there are changes, it is rewritten with one per change.
+class ChangeLog {
+  private:
+    static constexpr std::size_t COMPACT_MIN_RECORDS = 4096;
+    static constexpr std::size_t COMPACT_FACTOR = 4; // records per pending change before the file gets rewritten
+
+    Logger& logger_;
+    std::filesystem::path path_;
+    std::ofstream out_;
+    std::size_t records_ = 0; // change records in the file
+
+    class Reader;
+
+    static void encode(std::string& out, std::size_t key, const Change* change);
+    static std::optional<Change> decode(Reader& reader, std::size_t key, std::vector<ImTable>& tables, const DbService& dbService);
+    bool writeFrame(std::ofstream& out, const std::string& payload);
+    void fail(const std::string& action);
+
+  public:
+    explicit ChangeLog(Logger& cLogger) : logger_(cLogger) {}
+
+    bool isOpen() const;
+    // the changes the file at path describes, tables resolved against the current snapshot; nullopt if the
+    // file is something else and must not be touched. Appending starts with the next compact.
+    std::optional<std::vector<Change>> load(const std::filesystem::path& path, const DbService& dbService);
+    // current state of every key, absent ones are recorded as removed
+    void append(std::span<const std::size_t> keys, const ChangeStore& store);
+    bool wantsCompaction(std::size_t pendingChanges) const;
+    // replaces the file by one holding exactly the store, through a temporary file so a crash keeps either of them
+    void compact(const ChangeStore& store);
+};
@@ -1,22 +1,114 @@
 #pragma once
 
 #include "change.hpp"
+#include "changeLog.hpp"
 #include "dbService.hpp"
+#include "flatContainers.hpp"
 #include "logger.hpp"
 
+#include <deque>
 #include <mutex>
+#include <optional>
+#include <set>
+#include <shared_mutex>
+#include <span>
+
+using ChangeImage = std::pair<std::size_t, std::optional<Change>>; // change key and its state, nullopt while absent
+
+// Pending changes by change key, stored contiguously and found through a flat index instead of a tree.
+// Every write access counts as a modification of the change's table, that is what snapshots get rebuilt from.
+class ChangeStore {
+  private:
+    SlotMap<Change> changes_;
+    FlatHashMap<std::size_t, SlotHandle> handles_;
+    std::set<std::string> dirtyTables_;
+    std::size_t version_ = 0;
+    bool recording_ = false;
+    std::vector<ChangeImage> recorded_; // state before the first write since startRecording, one per change
+    FlatHashMap<std::size_t, bool> recordedKeys_;
+    bool tracking_ = false;
+    std::vector<std::size_t> written_; // keys written since takeWritten, each once
+    FlatHashMap<std::size_t, bool> writtenKeys_;
+
+    void markDirty(const std::string& table);
+    void record(std::size_t key);
+
+  public:
+    bool contains(std::size_t key) const;
+    const Change* find(std::size_t key) const;
+    const Change& at(std::size_t key) const;
+    Change& edit(std::size_t key);
+    // keyed by change.getKey()
+    void insertOrAssign(Change change);
+    bool erase(std::size_t key);
+    // moved out, nullopt if absent
+    std::optional<Change> take(std::size_t key);
+    std::size_t size() const;
+    void reserve(std::size_t count);
+    std::size_t version() const;
+    std::set<std::string> takeDirtyTables();
+    void startRecording();
+    std::vector<ChangeImage> stopRecording();
+    void trackWrites();
+    std::vector<std::size_t> takeWritten();
+    auto begin() const { return changes_.begin(); }
+    auto end() const { return changes_.end(); }
+};
+
+struct TableKeys {
+    FlatHashMap<std::size_t, std::size_t> pKeys; // primaryKey -> changeKey
+    FlatHashMap<std::string, std::size_t> uKeys; // uKey value -> changeKey
+};
+
+struct IdPool {
+    std::vector<std::size_t> ids; // reserved from the table's sequence, handed out from the back, smallest first
+    std::size_t nextBlock = 0;    // grows with every refill
+};
+using ReservedIds = std::map<std::string, std::vector<std::size_t>>; // taken from the pools for one call, by table
+
+struct ValidityCount {
+    uint32_t invalidChildren = 0; // present children the parent counts as invalid
+    bool counted = true;          // validity this change last reported to its parents
+};
+
+// What a journal entry touched, as it was before. Putting the images back undoes the entry, the images taken right
+// before that redo it, so either way costs as much as the entry's operations touched and not the whole tracker.
+struct JournalImages {
+    std::vector<ChangeImage> changes;
+    std::vector<std::pair<std::size_t, std::optional<ValidityCount>>> validity;
+    std::map<std::string, std::size_t> maxPKeys;
+};
+
+struct Journal {
+    std::deque<JournalImages> undo;
+    std::deque<JournalImages> redo;
+    std::optional<JournalImages> open; // the entry the running operations record into
+    FlatHashMap<std::size_t, bool> validityRecorded;
+    std::size_t groups = 0; // open journal groups, their operations share one entry
+};
 
 struct ProtectedChanges {
-    std::mutex mtx;
-    Change::chHashM flatData;
-    Change::ctPKMD pKeyMappedData;         // table -> primaryKey -> changeKey
-    Change::ctUKMD uKeyMappedData;         // table -> uKey value -> changeKey
+    std::shared_mutex mtx; // queries share it, anything writing the changes or the cached snapshot holds it alone
+    ChangeStore flatData;
+    std::map<std::string, TableKeys> tableKeys;
     std::unordered_set<std::size_t> roots; // changes without parent
     std::map<std::string, std::size_t> maxPKeys;
+    FlatHashMap<std::size_t, ValidityCount> validity; // keyed by change key, kept in step by settleValidityL
+    std::shared_ptr<const uiChangeInfo> snapshot; // last one handed out, reused until flatData changes
+    Journal journal;
 };
 
 enum class ChangeAddResult { ALREADY_EXISTING, INVALID, INTERNAL_FAILURE, SUCCESS };
 
+// A change validated and with its required changes looked up against the db snapshot alone, so any thread can prepare it.
+struct PreparedChange {
+    Change change;
+    bool valid = false;
+    std::vector<Change> required; // as far as the snapshot knows, pending changes are considered when adding
+    bool probe = false;           // added ends the sequence, not added does not
+};
+using PreparedSequence = std::vector<PreparedChange>; // added in order until a change is not added
+
 class ChangeTracker {
   private:
     ProtectedChanges changes_;
@@ -26,43 +118,114 @@ class ChangeTracker {
 
     DbService& dbService_;
     Logger& logger_;
+    ChangeLog log_; // guarded by changes_.mtx
 
     std::map<std::string, std::size_t> initialMaxPKeys_;
 
+    std::mutex idMtx_; // taken after changes_.mtx, never before
+    std::map<std::string, IdPool> idPools_;
+
+    static constexpr std::size_t MAX_JOURNAL_ENTRIES = 32;
+    static constexpr std::size_t MIN_ID_BLOCK = 64;
+    static constexpr std::size_t MAX_ID_BLOCK = 4096;
+
     void mergeCellChanges(Change& existingChange, const Change& newChange);
     void waitIfFrozen();
     bool isConflicting(const Change& newChange);
-    Change& manageConflictL(Change& newChange);
-    void collectRequiredChangesL(Change& change, std::vector<Change>& out);
-    std::size_t findExistingRequired(const Change& change);
+    Change& manageConflictL(Change& newChange, const DbSnapshot& db);
+    bool isUKeyTakenL(const Change& change, const DbSnapshot& db);
+    void collectRequiredChangesL(Change& change, std::vector<Change>& out, const DbSnapshot& db);
+    void collectRequiredChangesL(Change& change, std::vector<Change>& out, std::vector<Change> required, const DbSnapshot& db);
+    std::size_t findExistingRequired(const Change& change, const DbSnapshot& db);
     void handleRequiredChildrenMismatch(Change& change, std::vector<Change>& rChanges);
-    bool releaseDependancy(Change& change, const Change& rC);
+    bool releaseDependancy(Change& change, const Change& rC, const DbSnapshot& db);
     void releaseAllDependancies(Change& change);
-    void allocateIds(std::vector<Change>& changes);
-    bool addChangeInternalL(const Change& change);
+    void countNewRows(const Change& change, const DbSnapshot& db, std::map<std::string, std::size_t>& rows) const;
+    void countNewRowsL(const PreparedChange& prepared, const DbSnapshot& db, std::map<std::string, std::size_t>& rows);
+    bool allocateIds(std::vector<Change>& changes, ReservedIds& ids);
+    ReservedIds takeIds(const std::map<std::string, std::size_t>& rows);
+    void topUpIds(IdPool& pool, const std::string& table, std::size_t missing);
+    void returnIds(ReservedIds& ids);
+    bool addChangeInternalL(Change change);
+    ChangeAddResult addPreparedL(PreparedChange& prepared, std::vector<std::size_t>& added, const DbSnapshot& db, ReservedIds& ids);
+    void recountValidityL(Change& change);
+    void publishValidityL(const Change& change, std::vector<std::size_t>& pending);
+    void reportToParentsL(const Change& change, bool valid, std::vector<std::size_t>& pending);
+    void flushValidityL(std::vector<std::size_t>& pending);
+    void settleValidityL(const std::vector<std::size_t>& added);
     void collectAllDescendants(std::size_t key, std::unordered_set<std::size_t>& collected);
-    void removeChangeL(std::size_t key);
+    void removeChangesL(const std::unordered_set<std::size_t>& keys);
+    void removeChangeL(std::size_t key, std::set<std::string>& staleMaxPKeys, std::vector<std::size_t>& pending);
+    void collectSubtreeL(std::size_t key, std::unordered_set<std::size_t>& visited, std::vector<Change>& order) const;
+    ValidityCount& validityL(std::size_t key);
+    void recordValidityL(std::size_t key);
+    void openEntryL();
+    void closeEntryL();
+    void clearJournalL();
+    JournalImages swapImagesL(JournalImages images);
+    bool replayL(std::deque<JournalImages>& from, std::deque<JournalImages>& to);
+    void persistL();
+    bool isRecoverableL(Change& change) const;
+    std::size_t recoverL(std::vector<Change> logged);
     void logDetail(std::string content);
 
   public:
-    ChangeTracker(DbService& cDbService, Logger& cLogger) : dbService_(cDbService), logger_(cLogger) {}
+    ChangeTracker(DbService& cDbService, Logger& cLogger) : dbService_(cDbService), logger_(cLogger), log_(cLogger) {}
 
     void freeze();
     void unfreeze();
     std::optional<Change> getChange(const std::size_t key);
-    void propagateValidity(Change& change);
     ChangeAddResult addChange(Change change, std::optional<uint32_t> existingRowId = std::nullopt);
+    // one lock and one validity pass for the whole batch, updates carry their row id already; one result per change
+    std::vector<ChangeAddResult> addChanges(std::span<Change> changes);
+    // touches no tracker state, safe to call from many threads at once
+    PreparedChange prepareChange(const DbSnapshot& db, Change change, std::optional<uint32_t> existingRowId = std::nullopt) const;
+    // all sequences under one lock against the snapshot they were prepared on, returns change key and result of every
+    // change that was attempted
+    std::vector<std::pair<std::size_t, ChangeAddResult>> addPrepared(std::vector<PreparedSequence>& sequences, const DbSnapshot& db);
     void removeChanges(const std::size_t key);
     void removeChanges(const Change::chHashV& changeHashes);
-    uiChangeInfo getSnapShot();
+    std::shared_ptr<const uiChangeInfo> getSnapShot();
     void setMaxPKeys(std::map<std::string, std::size_t> pk);
+    // ids the database handed out on execution, rows counted up from here on come after them
+    void raiseMaxPKeys(const std::map<std::string, std::size_t>& rowIds);
     std::size_t getMaxPKey(const std::string table);
     bool isChangeSelected(const std::size_t hash);
     void toggleChangeSelect(const std::size_t hash);
     void setChangeRecL(Change& change, bool value);
     bool hasChild(const std::size_t hash);
     std::vector<std::size_t> getChildren(const std::size_t key);
+    // every change below and including the roots under one read lock, children before their parents and each only once
+    std::vector<Change> collectSubtrees(std::span<const std::size_t> roots);
     std::vector<std::size_t> getCalcRoots();
     std::unordered_set<std::size_t> getRoots();
     static bool gotAdded(ChangeAddResult result);
+
+    // Adding and removing changes is journaled, every call one entry. Calls between begin and end share one entry
+    // instead, so a whole csv import is undone at once, edits made meanwhile included. Groups nest.
+    void beginJournalGroup();
+    void endJournalGroup();
+    // both refuse while a group is open
+    bool undo();
+    bool redo();
+    bool canUndo();
+    bool canRedo();
+    // once the changes were applied to the database, bringing them back would apply them twice
+    void clearJournal();
+
+    // Every operation from now on is written to the log at path. What an earlier run left there comes back first, less
+    // what the current snapshot no longer allows and the changes needing that. Once, after setMaxPKeys and before any
+    // change is added; returns how many changes came back.
+    std::size_t openChangeLog(const std::filesystem::path& path);
+
+    class JournalGroup {
+      private:
+        ChangeTracker& tracker_;
+
+      public:
+        explicit JournalGroup(ChangeTracker& cTracker) : tracker_(cTracker) { tracker_.beginJournalGroup(); }
+        ~JournalGroup() { tracker_.endJournalGroup(); }
+        JournalGroup(const JournalGroup&) = delete;
+        JournalGroup& operator=(const JournalGroup&) = delete;
+    };
 };
\ No newline at end of file
@@ -34,8 +34,12 @@ class Config {
     ApiConfig api_;
     ReaderConfig order_;
     ReaderConfig bom_;
+    CSV::TypeSampling typeSampling_;
 
     std::filesystem::path autoInvArchivePath;
+    std::filesystem::path pendingChangesPath_;
+    bool reserveIds_ = false;
+    bool checkConflicts_ = false;
 
     Logger& logger_;
 
@@ -64,4 +68,8 @@ class Config {
     std::filesystem::path getCsvPathOrder() const;
     std::filesystem::path getCsvPathBom() const;
     std::filesystem::path getAutoInvArchivePath() const;
+    std::filesystem::path getPendingChangesPath() const;
+    bool getReserveIds() const;
+    bool getCheckConflicts() const;
+    const CSV::TypeSampling& getTypeSampling() const;
 };
\ No newline at end of file
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "csvScanner.hpp"
+#include "logger.hpp"
+
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// Read only view of a whole file, mapped instead of read so large exports never get copied into the process.
+class MappedFile {
+  private:
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+#ifdef _WIN32
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#endif
+
+    void close();
+
+  public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // an empty file opens fine and maps nothing
+    bool open(const std::filesystem::path& path);
+    std::string_view view() const;
+};
+
+// Owns the fields that could not stay views into the file, i.e. quoted fields containing "" escapes.
+// Blocks are never moved or freed before the arena dies, so handed out views stay valid.
+class CsvArena {
+  private:
+    static constexpr std::size_t BLOCK_SIZE = 64 * 1024;
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    std::size_t used_ = BLOCK_SIZE;
+
+  public:
+    char* allocate(std::size_t size);
+};
+
+// Records of one nextChunk call, fields stored flat.
+struct CsvChunk {
+    std::vector<std::string_view> fields;
+    std::vector<std::size_t> rowStarts; // index into fields, one entry per record
+    std::size_t firstRow = 0;           // record number of row(0) within the file
+
+    void clear();
+    std::size_t rowCount() const;
+    std::span<const std::string_view> row(std::size_t index) const;
+};
+
+// RFC 4180 reader: quoted fields may contain separators, "" and line breaks, records end with LF or CRLF.
+// Leniencies: a leading UTF-8 BOM and empty lines are skipped, a quote inside a field opens a quoted section there,
+// like the old line parser did. Returned views point into the mapping or the arena and live as long as the reader.
+// Field boundaries come from CsvScan, see csvScanner.hpp.
+class CsvReader {
+  private:
+    Logger& logger_;
+    MappedFile file_;
+    std::string_view data_;
+    std::size_t pos_ = 0;
+    std::size_t rowsRead_ = 0;
+    bool failed_ = false;
+    CsvScanMode scanMode_ = CsvScanMode::AUTO;
+    CsvArena arena_;
+
+    std::string_view makeField(std::size_t start, std::size_t end);
+    std::size_t lineOf(std::size_t position) const;
+
+  public:
+    explicit CsvReader(Logger& cLogger);
+    CsvReader(const CsvReader&) = delete;
+    CsvReader& operator=(const CsvReader&) = delete;
+
+    bool open(const std::filesystem::path& path);
+    // parses from memory instead, the buffer has to outlive the reader
+    void openBuffer(std::string_view buffer);
+
+    // replaces chunk's content with up to maxRows records, false once nothing is left or the input is malformed
+    bool nextChunk(CsvChunk& chunk, std::size_t maxRows);
+    bool failed() const;
+    std::size_t getSize() const;
+    void setScanMode(CsvScanMode mode);
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Structural scanning for CsvReader, simdcsv style: 64 bytes are classified at once into bitmasks (bit i = byte i),
+// quoted regions follow from a prefix xor over the quote mask, so the parser only visits separators and record ends
+// that really delimit fields.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CSV_SCAN_SSE2
+#endif
+
+constexpr std::size_t CSV_BLOCK_SIZE = 64;
+
+enum class CsvScanMode : uint8_t { AUTO, SCALAR }; // SCALAR forces the fallback, for comparison
+
+struct CsvBlockMasks {
+    uint64_t quotes;
+    uint64_t separators;
+    uint64_t recordEnds; // '\n' and '\r'
+};
+
+namespace CsvScan {
+// block has to hold CSV_BLOCK_SIZE readable bytes
+CsvBlockMasks classify(const char* block);
+CsvBlockMasks classifyScalar(const char* block);
+
+// bit i becomes the xor of bits 0..i
+inline uint64_t prefixXor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+// bytes between an opening and a closing quote, "" toggles twice and stays inside. carry is all ones while a quoted
+// region continues into the next block.
+inline uint64_t insideQuotes(uint64_t quotes, uint64_t& carry) {
+    const uint64_t inside = prefixXor(quotes) ^ carry;
+    carry = static_cast<uint64_t>(static_cast<int64_t>(inside) >> 63);
+    return inside;
+}
+} // namespace CsvScan
@@ -3,6 +3,8 @@
 #include <algorithm>
 #include <charconv>
 #include <condition_variable>
+#include <string_view>
+#include <variant>
 
 #include <nlohmann/json.hpp>
 
@@ -82,7 +84,14 @@ struct Data {
     std::vector<DB::TypeCategory> columnTypes;
 };
 
-inline bool isInteger(const std::string& s) {
+// Which rows type inference looks at. Both zero checks every row, otherwise the first headRows rows plus sampledRows
+// picked at random from the rest.
+struct TypeSampling {
+    std::size_t headRows = 0;
+    std::size_t sampledRows = 0;
+};
+
+inline bool isInteger(std::string_view s) {
     if (s.empty()) { return false; }
 
     size_t i = 0;
@@ -98,7 +107,7 @@ inline bool isInteger(const std::string& s) {
     return true;
 }
 
-inline bool isFloating(const std::string& s) {
+inline bool isFloating(std::string_view s) {
     if (s.empty()) { return false; }
 
     bool seenDot = false;
@@ -139,21 +148,23 @@ inline bool isFloating(const std::string& s) {
     return seenDigit && seenDot;
 }
 
-inline bool isBoolean(std::string s) {
-    for (auto& c : s) {
-        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
-    }
-    return (s == "true" || s == "false");
+// lower has to be lowercase already
+inline bool equalsIgnoreCase(std::string_view s, std::string_view lower) {
+    return std::ranges::equal(s, lower, [](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == b; });
+}
+
+inline bool isBoolean(std::string_view s) {
+    return equalsIgnoreCase(s, "true") || equalsIgnoreCase(s, "false");
 }
 
-inline bool looksLikeJson(const std::string& s) {
+inline bool looksLikeJson(std::string_view s) {
     if (s.size() < 2) { return false; }
     char first = s.front();
     char last = s.back();
     return (first == '{' && last == '}') || (first == '[' && last == ']');
 }
 
-inline DB::TypeCategory detectTypeCategory(const std::string& value) {
+inline DB::TypeCategory detectTypeCategory(std::string_view value) {
     if (value.empty()) return DB::TypeCategory::OTHER;
     if (isBoolean(value)) return DB::TypeCategory::BOOLEAN;
     if (isInteger(value)) return DB::TypeCategory::INTEGER;
@@ -163,23 +174,28 @@ inline DB::TypeCategory detectTypeCategory(const std::string& value) {
     return DB::TypeCategory::TEXT;
 }
 
+// Order independent, so partial results of row chunks can be merged in any order. Only integers widen to floating,
+// every other mix is text.
 inline DB::TypeCategory widenType(DB::TypeCategory a, DB::TypeCategory b) {
     if (a == DB::TypeCategory::OTHER) { return b; }
     if (b == DB::TypeCategory::OTHER) { return a; }
     if (a == b) { return a; }
-    if (a == DB::TypeCategory::TEXT || b == DB::TypeCategory::TEXT) { return DB::TypeCategory::TEXT; }
-    if (a == DB::TypeCategory::FLOATING || b == DB::TypeCategory::FLOATING) { return DB::TypeCategory::FLOATING; }
+    const auto isNumber = [](DB::TypeCategory t) { return t == DB::TypeCategory::INTEGER || t == DB::TypeCategory::FLOATING; };
+    if (isNumber(a) && isNumber(b)) { return DB::TypeCategory::FLOATING; }
     return DB::TypeCategory::TEXT;
 }
 
+inline void widenTypes(const std::vector<std::string>& row, std::vector<DB::TypeCategory>& types) {
+    for (std::size_t j = 0; j < row.size() && j < types.size(); j++) {
+        types[j] = widenType(detectTypeCategory(row[j]), types[j]);
+    }
+}
+
 inline std::vector<DB::TypeCategory> determineTypes(const std::vector<std::vector<std::string>>& rows) {
     if (rows.empty()) { return std::vector<DB::TypeCategory>{}; }
     std::vector<DB::TypeCategory> resultTypes(rows.front().size(), DB::TypeCategory::OTHER);
-    for (std::size_t i = 0; i < rows.size(); i++) {
-        if (i == 0) { continue; }
-        for (std::size_t j = 0; j < rows[i].size(); j++) {
-            resultTypes[j] = widenType(detectTypeCategory(rows[i][j]), resultTypes[j]);
-        }
+    for (std::size_t i = 1; i < rows.size(); i++) {
+        widenTypes(rows[i], resultTypes);
     }
     return resultTypes;
 }
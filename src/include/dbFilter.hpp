@@ -25,8 +25,11 @@ class DbFilter {
     std::shared_ptr<const CompleteDbData> dbData_;
     UI::DataStates& dataStates_;
 
-    std::future<std::shared_ptr<const CompleteDbData>> fFilteredData_;
+    std::shared_ptr<const CompleteDbData> filteredData_;
+    std::atomic<bool> filteredReady_{false};
+    std::atomic<std::size_t> filterGeneration_{0};
     std::mutex filterMtx_;
+    std::mutex resultMtx_;
 
     std::shared_ptr<const CompleteDbData> filterByKeyword(const std::string& keyword, float similarityThreshhold);
     HitMap findHitsByKeyword(const std::string& keyword, float similarityThreshhold);
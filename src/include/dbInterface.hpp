@@ -7,6 +7,7 @@
 #include <algorithm>
 #include <iostream>
 #include <mutex>
+#include <optional>
 
 #include <pqxx/pqxx>
 
@@ -27,6 +28,7 @@ struct HeaderInfo {
     DB::DataType dataType;
     std::size_t depth = 0;
     bool nullable = true;
+    std::string sqlType; // as postgres formats it, numeric(10,2) say
 };
 
 using HeaderVector = std::vector<HeaderInfo>;
@@ -41,12 +43,20 @@ using StringVector = std::vector<std::string>;
 using HeaderMap = std::map<std::string, HeadersInfo>;
 using ColumnDataMap = std::map<std::string, StringVector>;
 using RowMap = std::map<std::string, ColumnDataMap>;
+using NullMap = std::map<std::string, std::map<std::string, std::vector<bool>>>; // table -> column -> row is NULL
 
 struct CompleteDbData {
     StringVector tables;
     HeaderMap headers;
     RowMap tableRows;
     std::map<std::string, std::size_t> maxPKeys;
+    NullMap nullCells; // the rows read NULL as empty, only columns holding one are listed
+};
+
+struct AppliedChanges {
+    Change::chHashV keys;                        // executed successfully
+    Change::chHashV conflicts;                   // their row no longer held the expected cells, nothing was changed
+    std::map<std::string, std::size_t> maxRowIds; // highest id an insert got per table, as returned by the database
 };
 
 struct ProtectedConnData {
@@ -61,6 +71,7 @@ class DbInterface {
     DB::ProtectedData<StringVector> tables_;
     DB::ProtectedData<HeaderMap> tableHeaders_;
     DB::ProtectedData<RowMap> tableRows_;
+    NullMap tableNulls_; // guarded by tableRows_.mtx
     Logger& logger_;
 
     ProtectedConnData connData_;
@@ -70,13 +81,15 @@ class DbInterface {
     std::size_t computeDepth(HeaderInfo& header);
     void assignDependencyIndexes();
     void acquireTableRows(const std::string& table, const HeadersInfo& cols);
-    bool applySingleChange(const Change& change, SqlAction action);
+    bool applySingleChange(const Change& change, SqlAction action, AppliedChanges& applied);
 
   public:
     DbInterface(Logger& cLogger);
     void initializeWithConfigString(const std::string& confString);
-    void acquireTables();
-    void acquireTableContent();
-    CompleteDbData acquireAllTablesRows();
-    Change::chHashV applyChanges(std::vector<Change> changes, SqlAction action);
+    bool acquireTables();
+    bool acquireTableContent();
+    std::optional<CompleteDbData> acquireAllTablesRows();
+    AppliedChanges applyChanges(std::vector<Change> changes, SqlAction action);
+    // count ids from the sequence behind the primary key, the database never hands them out again; empty on failure
+    std::vector<std::size_t> reserveIds(const std::string& table, const std::string& pkey, std::size_t count);
 };
\ No newline at end of file
@@ -8,12 +8,59 @@
 
 #include <expected>
 #include <future>
+#include <string_view>
+#include <unordered_map>
 
 struct IndexPKeyPair {
     std::size_t index;
     std::size_t pkey;
 };
 
+// Key columns of a snapshot hashed once, so lookups while generating changes do not scan whole columns.
+// The views point into the snapshot the keys were built from.
+struct SnapshotKeys {
+    std::map<std::string, std::unordered_map<std::string_view, std::size_t>> uKeys; // table -> ukey value -> row index
+    std::map<std::string, std::unordered_map<std::string_view, std::size_t>> pKeys; // table -> pkey value -> row index
+};
+
+// One published snapshot with its keys and the queries on it. A copy keeps both alive, so whoever holds one can go on
+// querying while a refetch publishes the next, and a batch of queries sees one consistent state.
+class DbSnapshot {
+  private:
+    std::shared_ptr<const CompleteDbData> dbData_;
+    std::shared_ptr<const SnapshotKeys> keys_; // of dbData_
+    const Config& config_;
+    Logger& logger_;
+
+  public:
+    DbSnapshot(std::shared_ptr<const CompleteDbData> cData,
+               std::shared_ptr<const SnapshotKeys> cKeys,
+               const Config& cConfig,
+               Logger& cLogger)
+        : dbData_(std::move(cData)), keys_(std::move(cKeys)), config_(cConfig), logger_(cLogger) {}
+
+    const CompleteDbData& getData() const { return *dbData_; }
+
+    IndexPKeyPair findIndexAndPKeyOfExisting(const std::string& table, const Change::colValMap& cells) const;
+    std::size_t findIndexOfPKey(const std::string& table, std::string_view pkey) const; // INVALID_ID if the row is not loaded
+    bool hasQuantityColumn(const std::string& table) const;
+    void updateChangeQuantity(const std::string& table,
+                              Change::colValMap& cells,
+                              const std::size_t index,
+                              DB::QuantityOperation operation) const;
+    // with conflict checks enabled, the update or delete only applies while the row at index still holds these values
+    void captureExpectedCells(Change& change, std::size_t index) const;
+    bool validateChange(Change& change, bool fromGeneration) const;
+    std::vector<Change> getRequiredChanges(const Change& change, const std::map<std::string, std::size_t>& ids) const;
+    bool checkReferencedPKeyValue(const std::string& ref, const std::string& val) const;
+    bool checkReferencedUKeyValue(const std::string& ref, bool nullable, const std::string& val) const;
+    ImTable getTable(const std::string& tableName) const;
+    std::string getTableUKey(const std::string& table) const;
+    std::string getTablePKey(const std::string& table) const;
+    HeaderInfo getTableHeaderInfo(const std::string& table, const std::string& header) const;
+    bool hasColumn(const std::string& table, std::string_view column) const;
+};
+
 class DbService {
   private:
     DbInterface& dbInterface_;
@@ -21,35 +68,56 @@ class DbService {
     Config& config_;
     Logger& logger_;
 
-    std::future<CompleteDbData> fCompleteDbData_;
     std::shared_ptr<const CompleteDbData> dbData_;
-    std::unique_ptr<CompleteDbData> pendingData_;
-    std::future<std::map<std::string, std::size_t>> fMaxPKeys_;
+    std::shared_ptr<const SnapshotKeys> keys_;            // of dbData_
+    mutable std::mutex snapshotMtx_;                      // the ui thread swaps dbData_ and keys_, others pin them
+    std::shared_ptr<const CompleteDbData> publishedData_; // finished by the load pipeline, not yet picked up
+    std::shared_ptr<const SnapshotKeys> publishedKeys_;
+    std::mutex publishMtx_;
+    std::atomic<std::size_t> loadGeneration_{0};
 
     std::atomic<bool> dataAvailable_{false};
 
     bool isDataReady();
+    Task<void> loadData(bool withStructure);
+    void publishData(std::shared_ptr<const CompleteDbData> data, std::size_t generation);
 
   public:
     DbService(DbInterface& cDbData, ThreadPool& cPool, Config& cConfig, Logger& cLogger);
-    void startUp();
-    void refetch();
+    // both finish once the snapshot is published or loading failed, the ui polls getCompleteData instead of waiting
+    Task<void> startUp();
+    Task<void> refetch();
+    // publishes a prebuilt snapshot as if it was loaded, for benchmarks and tools running without a database
+    void injectData(std::shared_ptr<const CompleteDbData> data);
     std::expected<std::shared_ptr<const CompleteDbData>, bool> getCompleteData();
     std::map<std::string, std::size_t> calcMaxPKeys(const CompleteDbData& data) const;
-    IndexPKeyPair findIndexAndPKeyOfExisting(const std::string& table, const Change::colValMap& cells) const;
-    bool hasQuantityColumn(const std::string& table) const;
-    void updateChangeQuantity(const std::string& table,
-                              Change::colValMap& cells,
-                              const std::size_t index,
-                              DB::QuantityOperation operation) const;
+    SnapshotKeys calcKeys(const CompleteDbData& data) const;
+    // the published snapshot, pinned for a caller off the ui thread or one needing the same state across calls
+    DbSnapshot getSnapshot() const;
     bool validateCompleteDbData(const CompleteDbData& data) const;
-    bool validateChange(Change& change, bool fromGeneration) const;
-    std::vector<Change> getRequiredChanges(const Change& change, const std::map<std::string, std::size_t>& ids) const;
-    bool checkReferencedPKeyValue(const std::string& ref, const std::string& val) const;
-    bool checkReferencedUKeyValue(const std::string& ref, bool nullable, const std::string& val) const;
     void initializeDbInterface(const std::string& configString) const;
-    std::future<Change::chHashV> requestChangeApplication(std::vector<Change> changes, SqlAction action) const;
-    ImTable getTable(const std::string& tableName) const;
-    std::string getTableUKey(const std::string& table) const;
-    HeaderInfo getTableHeaderInfo(const std::string& table, const std::string& header) const;
+    Task<AppliedChanges> requestChangeApplication(std::vector<Change> changes, SqlAction action) const;
+    // new rows get ids reserved from the database instead of counting up from the highest loaded key
+    bool reservesIds() const;
+    std::vector<std::size_t> reserveIds(const std::string& table, std::size_t count) const;
+
+    // single queries on the published snapshot, see DbSnapshot
+    IndexPKeyPair findIndexAndPKeyOfExisting(const std::string& table, const Change::colValMap& cells) const {
+        return getSnapshot().findIndexAndPKeyOfExisting(table, cells);
+    }
+    std::size_t findIndexOfPKey(const std::string& table, std::string_view pkey) const {
+        return getSnapshot().findIndexOfPKey(table, pkey);
+    }
+    bool hasQuantityColumn(const std::string& table) const { return getSnapshot().hasQuantityColumn(table); }
+    void captureExpectedCells(Change& change, std::size_t index) const { getSnapshot().captureExpectedCells(change, index); }
+    bool validateChange(Change& change, bool fromGeneration) const { return getSnapshot().validateChange(change, fromGeneration); }
+    std::vector<Change> getRequiredChanges(const Change& change, const std::map<std::string, std::size_t>& ids) const {
+        return getSnapshot().getRequiredChanges(change, ids);
+    }
+    bool checkReferencedPKeyValue(const std::string& ref, const std::string& val) const {
+        return getSnapshot().checkReferencedPKeyValue(ref, val);
+    }
+    ImTable getTable(const std::string& tableName) const { return getSnapshot().getTable(tableName); }
+    std::string getTableUKey(const std::string& table) const { return getSnapshot().getTableUKey(table); }
+    bool hasColumn(const std::string& table, std::string_view column) const { return getSnapshot().hasColumn(table, column); }
 };
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Open addressing hash map with linear probing. Erasing shifts the following entries back instead of leaving tombstones,
+// so probes stay short however many entries came and went. Entries move on insert and erase, only keys are stable.
+template <typename K, typename V, typename Hash = std::hash<K>> class FlatHashMap {
+  private:
+    struct Slot {
+        std::pair<K, V> entry;
+        bool used = false;
+    };
+    static constexpr std::size_t MIN_CAPACITY = 16;
+    static constexpr std::size_t NPOS = std::numeric_limits<std::size_t>::max();
+
+    std::vector<Slot> slots_;
+    std::size_t size_ = 0;
+    int shift_ = 64;
+
+    std::size_t mask() const { return slots_.size() - 1; }
+
+    std::size_t home(const K& key) const {
+        // fibonacci hashing, the sequential ids this mostly holds would otherwise cluster
+        return static_cast<std::size_t>((static_cast<uint64_t>(Hash{}(key)) * 0x9E3779B97F4A7C15ull) >> shift_);
+    }
+
+    std::size_t findSlot(const K& key) const {
+        if (size_ == 0) { return NPOS; }
+        for (std::size_t i = home(key);; i = (i + 1) & mask()) {
+            if (!slots_[i].used) { return NPOS; }
+            if (slots_[i].entry.first == key) { return i; }
+        }
+    }
+
+    void rehash(std::size_t capacity) {
+        std::vector<Slot> old = std::exchange(slots_, std::vector<Slot>(capacity));
+        shift_ = 64 - std::countr_zero(capacity);
+        size_ = 0;
+        for (Slot& slot : old) {
+            if (slot.used) { emplaceNew(std::move(slot.entry.first), std::move(slot.entry.second)); }
+        }
+    }
+
+    // key is not present and there is room for it
+    V& emplaceNew(K key, V value) {
+        std::size_t i = home(key);
+        while (slots_[i].used) {
+            i = (i + 1) & mask();
+        }
+        slots_[i].entry = {std::move(key), std::move(value)};
+        slots_[i].used = true;
+        ++size_;
+        return slots_[i].entry.second;
+    }
+
+    void reserveOneMore() {
+        // at most 3/4 full
+        if ((size_ + 1) * 4 > slots_.size() * 3) { rehash(std::max(MIN_CAPACITY, slots_.size() * 2)); }
+    }
+
+  public:
+    class ConstIterator {
+      private:
+        const Slot* slot_;
+        const Slot* end_;
+
+        void skipUnused() {
+            while (slot_ != end_ && !slot_->used) {
+                ++slot_;
+            }
+        }
+
+      public:
+        ConstIterator(const Slot* cSlot, const Slot* cEnd) : slot_(cSlot), end_(cEnd) { skipUnused(); }
+        const std::pair<K, V>& operator*() const { return slot_->entry; }
+        const std::pair<K, V>* operator->() const { return &slot_->entry; }
+        ConstIterator& operator++() {
+            ++slot_;
+            skipUnused();
+            return *this;
+        }
+        bool operator==(const ConstIterator& other) const { return slot_ == other.slot_; }
+    };
+
+    ConstIterator begin() const { return ConstIterator{slots_.data(), slots_.data() + slots_.size()}; }
+    ConstIterator end() const { return ConstIterator{slots_.data() + slots_.size(), slots_.data() + slots_.size()}; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    void reserve(std::size_t count) {
+        const std::size_t capacity = std::bit_ceil(std::max(MIN_CAPACITY, count * 4 / 3 + 1));
+        if (capacity > slots_.size()) { rehash(capacity); }
+    }
+
+    void clear() {
+        slots_.clear();
+        size_ = 0;
+        shift_ = 64;
+    }
+
+    V* find(const K& key) {
+        const std::size_t i = findSlot(key);
+        return i == NPOS ? nullptr : &slots_[i].entry.second;
+    }
+
+    const V* find(const K& key) const {
+        const std::size_t i = findSlot(key);
+        return i == NPOS ? nullptr : &slots_[i].entry.second;
+    }
+
+    bool contains(const K& key) const { return findSlot(key) != NPOS; }
+
+    V& at(const K& key) {
+        if (V* value = find(key)) { return *value; }
+        throw std::out_of_range("FlatHashMap::at");
+    }
+
+    const V& at(const K& key) const {
+        if (const V* value = find(key)) { return *value; }
+        throw std::out_of_range("FlatHashMap::at");
+    }
+
+    V& operator[](const K& key) {
+        if (V* value = find(key)) { return *value; }
+        reserveOneMore();
+        return emplaceNew(key, V{});
+    }
+
+    void insertOrAssign(K key, V value) {
+        if (V* existing = find(key)) {
+            *existing = std::move(value);
+            return;
+        }
+        reserveOneMore();
+        emplaceNew(std::move(key), std::move(value));
+    }
+
+    bool erase(const K& key) {
+        const std::size_t i = findSlot(key);
+        if (i == NPOS) { return false; }
+        // pull back every following entry whose probe sequence passes the hole
+        std::size_t hole = i;
+        for (std::size_t j = (i + 1) & mask(); slots_[j].used; j = (j + 1) & mask()) {
+            const std::size_t distance = (j - home(slots_[j].entry.first)) & mask();
+            if (distance >= ((j - hole) & mask())) {
+                slots_[hole].entry = std::move(slots_[j].entry);
+                hole = j;
+            }
+        }
+        slots_[hole].entry = {};
+        slots_[hole].used = false;
+        --size_;
+        return true;
+    }
+};
+
+struct SlotHandle {
+    uint32_t index = std::numeric_limits<uint32_t>::max();
+    uint32_t generation = 0;
+};
+
+// Values stored contiguously, addressed through handles that stay valid while other values come and go.
+// Erasing moves the last value into the gap, a handle of an erased value never resolves again.
+template <typename T> class SlotMap {
+  private:
+    struct Slot {
+        uint32_t dense = 0;
+        uint32_t generation = 0;
+    };
+
+    std::vector<T> values_;
+    std::vector<uint32_t> owners_; // slot of every value
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> free_;
+
+  public:
+    SlotHandle insert(T value) {
+        uint32_t index;
+        if (!free_.empty()) {
+            index = free_.back();
+            free_.pop_back();
+        } else {
+            index = static_cast<uint32_t>(slots_.size());
+            slots_.emplace_back();
+        }
+        slots_[index].dense = static_cast<uint32_t>(values_.size());
+        values_.push_back(std::move(value));
+        owners_.push_back(index);
+        return SlotHandle{index, slots_[index].generation};
+    }
+
+    T* get(SlotHandle handle) {
+        if (handle.index >= slots_.size() || slots_[handle.index].generation != handle.generation) { return nullptr; }
+        return &values_[slots_[handle.index].dense];
+    }
+
+    const T* get(SlotHandle handle) const { return const_cast<SlotMap*>(this)->get(handle); }
+
+    bool erase(SlotHandle handle) {
+        if (!get(handle)) { return false; }
+        Slot& slot = slots_[handle.index];
+        const uint32_t last = static_cast<uint32_t>(values_.size() - 1);
+        if (slot.dense != last) {
+            values_[slot.dense] = std::move(values_[last]);
+            owners_[slot.dense] = owners_[last];
+            slots_[owners_[last]].dense = slot.dense;
+        }
+        values_.pop_back();
+        owners_.pop_back();
+        ++slot.generation;
+        free_.push_back(handle.index);
+        return true;
+    }
+
+    void reserve(std::size_t count) {
+        values_.reserve(count);
+        owners_.reserve(count);
+        slots_.reserve(count);
+    }
+
+    std::size_t size() const { return values_.size(); }
+    bool empty() const { return values_.empty(); }
+    auto begin() { return values_.begin(); }
+    auto end() { return values_.end(); }
+    auto begin() const { return values_.begin(); }
+    auto end() const { return values_.end(); }
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "dataTypes.hpp"
+#include "dbInterface.hpp"
+#include "logger.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Synthetic inventory shaped like the real one, for benchmarks and soak tests against a local database.
+// Layout: "parts" on top, below it `depth` levels of `fanout` tables each (manufacturers, footprints, locations, ...).
+// Every table references all tables of the level below, so parts' foreign keys end up with depth `depth`, exactly what
+// DbInterface::assignDependencyIndexes computes for the generated schema.
+// Everything is derived from the seed, the same options always give the same files.
+
+struct GeneratorOptions {
+    uint32_t seed = 42;
+    std::size_t parts = 10000;
+    std::size_t depth = 1;
+    std::size_t fanout = 3;
+    std::size_t rowsPerTable = 200; // every table except parts
+    std::size_t bomRows = 1000;
+    std::size_t orderRows = 1000;
+    double newPartShare = 0.1; // csv rows naming parts that are not in the database yet
+};
+
+class InventoryGenerator {
+  private:
+    GeneratorOptions options_;
+    CompleteDbData data_;
+    CSV::Data bom_;
+    CSV::Data order_;
+    nlohmann::json apiArchive_;
+
+    void generateTables();
+    void generateCsvs();
+    std::string partNumber(std::size_t index) const;
+
+  public:
+    static constexpr const char* PARTS_TABLE = "parts";
+    static constexpr const char* QUANTITY_COLUMN = "quantity";
+
+    explicit InventoryGenerator(GeneratorOptions cOptions);
+
+    const GeneratorOptions& getOptions() const;
+    // what DbService would hold after loading the generated database, with maxPKeys filled in
+    const CompleteDbData& getData() const;
+    const CSV::Data& getBom() const;
+    const CSV::Data& getOrder() const;
+    // keyed by the order's part numbers, in the shape Config::readApiArchive expects
+    const nlohmann::json& getApiArchive() const;
+
+    void writeSchemaSql(std::ostream& out) const;
+    // COPY blocks for psql, sequences are moved past the generated ids
+    void writeDataSql(std::ostream& out) const;
+
+    // schema.sql, data.sql, bom.csv, order.csv and apiArchive.json
+    bool writeFiles(const std::filesystem::path& directory, Logger& logger) const;
+};
@@ -1,42 +1,204 @@
 #pragma once
 
+#include "trace.hpp"
+
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
 #include <format>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 #define WITH_LOGGING
 
+// Messages below this level are compiled out of Logger::log, e.g. -DLOG_COMPILED_LEVEL=2 keeps INFO and up.
+#ifndef LOG_COMPILED_LEVEL
+#define LOG_COMPILED_LEVEL 0
+#endif
+
+// ERR instead of ERROR, windows.h defines the latter as a macro
+enum class LogLevel : uint8_t { TRACE, DEBUG, INFO, WARN, ERR };
+
+inline std::optional<LogLevel> logLevelFromString(std::string_view level) {
+    if (level == "trace") { return LogLevel::TRACE; }
+    if (level == "debug") { return LogLevel::DEBUG; }
+    if (level == "info") { return LogLevel::INFO; }
+    if (level == "warning") { return LogLevel::WARN; }
+    if (level == "error") { return LogLevel::ERR; }
+    return std::nullopt;
+}
+
+constexpr LogLevel COMPILED_LOG_LEVEL = static_cast<LogLevel>(LOG_COMPILED_LEVEL);
+constexpr std::size_t LOG_RING_CAPACITY = 4096; // power of two, entries beyond it are dropped instead of blocking
+constexpr std::size_t TRACE_RING_CAPACITY = 8192;
+constexpr std::size_t DEFAULT_LOG_RETENTION = 10000;
+
 class Log {
   private:
     std::string content_;
     std::chrono::time_point<std::chrono::steady_clock> timeOfCreation_;
+    LogLevel level_ = LogLevel::INFO;
+
+    static LogLevel levelFromContent(std::string_view content) {
+        if (content.starts_with("ERROR")) { return LogLevel::ERR; }
+        if (content.starts_with("WARN")) { return LogLevel::WARN; }
+        return LogLevel::INFO;
+    }
 
   public:
-    Log(std::string cLog) : content_(cLog) { timeOfCreation_ = std::chrono::steady_clock::now(); }
-    void print() {
+    Log() = default;
+    // the level is taken from the "ERROR:"/"WARNING:" prefix the messages already carry
+    Log(std::string cLog) : Log(levelFromContent(cLog), std::move(cLog)) {}
+    Log(LogLevel cLevel, std::string cLog) : content_(std::move(cLog)), level_(cLevel) {
+        timeOfCreation_ = std::chrono::steady_clock::now();
+    }
+
+    LogLevel getLevel() const { return level_; }
+    const std::string& getContent() const { return content_; }
+    void print(std::string& out) const {
         auto tp = timeOfCreation_.time_since_epoch(); // duration since steady_clock epoch
         auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(tp).count();
-        std::cout << milliseconds << ": " << content_ << '\n';
+        std::format_to(std::back_inserter(out), "{}: {}\n", milliseconds, content_);
     }
 };
 
+// Bounded ring, lock free for any number of producers, a single consumer drains it
+template <typename T, std::size_t Capacity> class MpscRing {
+  private:
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity has to be a power of two");
+
+    struct Slot {
+        std::atomic<std::size_t> sequence{0};
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    alignas(64) std::atomic<std::size_t> head_{0};
+    alignas(64) std::size_t tail_ = 0; // only touched by the consumer
+
+  public:
+    MpscRing() : slots_(std::make_unique<Slot[]>(Capacity)) {
+        for (std::size_t i = 0; i < Capacity; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // false if the ring is full, value is left untouched then
+    bool tryPush(T&& value) {
+        std::size_t pos = head_.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots_[pos & (Capacity - 1)];
+            const std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                // the slot is free for this lap, claim it
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(value);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // the consumer has not freed this slot yet
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T& out) {
+        Slot& slot = slots_[tail_ & (Capacity - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != tail_ + 1) { return false; }
+        out = std::move(slot.value);
+        slot.sequence.store(tail_ + Capacity, std::memory_order_release);
+        ++tail_;
+        return true;
+    }
+};
+
+// Producers only claim a slot in a bounded ring, a background thread prints and keeps the history. A full ring drops the
+// entry and counts it rather than stalling the caller. In trace mode the same thread also writes TraceRecords to a binary
+// file, see trace.hpp and tools/traceToChrome.cpp.
 class Logger {
   private:
-    std::vector<Log> logs_;
-    std::mutex mtx_;
+    MpscRing<Log, LOG_RING_CAPACITY> ring_;
+    MpscRing<TraceRecord, TRACE_RING_CAPACITY> traceRing_;
+    std::atomic<std::size_t> dropped_{0};
+    std::size_t reportedDropped_ = 0; // only touched by the flusher
+    std::atomic<std::size_t> traceDropped_{0};
+    std::size_t reportedTraceDropped_ = 0; // guarded by traceMtx_
+    std::atomic<LogLevel> minLevel_{LogLevel::INFO};
+
+    std::deque<Log> history_;
+    std::size_t retention_ = DEFAULT_LOG_RETENTION;
+    mutable std::mutex historyMtx_;
+
+    std::atomic<bool> tracing_{false};
+    std::atomic<uint64_t> nextSpanId_{1};
+    std::ofstream traceFile_;
+    std::mutex traceMtx_; // guards traceFile_ between the flusher and start/stopTrace
+
+    std::atomic<bool> stopping_{false};
+    std::thread flusher_;
+
+    void flushLoop();
+    void drain();
+    void drainTrace();
 
   public:
-    void pushLog(Log log) {
-        {
-            std::lock_guard<std::mutex> lock(mtx_);
-#ifdef WITH_LOGGING
-            log.print();
-#endif
+    Logger();
+    ~Logger();
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    void pushLog(Log log);
+    // formats only if the level passes both the compile time and the runtime filter
+    template <LogLevel Level, typename... Args> void log(std::format_string<Args...> fmt, Args&&... args) {
+        if constexpr (Level >= COMPILED_LOG_LEVEL) {
+            if (!isEnabled(Level)) { return; }
+            pushLog(Log{Level, std::format(fmt, std::forward<Args>(args)...)});
         }
-        logs_.emplace_back(log);
     }
-    void clearOldLogs(std::size_t amount) {}
-};
\ No newline at end of file
+    bool isEnabled(LogLevel level) const { return level >= minLevel_.load(std::memory_order_relaxed); }
+    void setMinLevel(LogLevel level) { minLevel_.store(level, std::memory_order_relaxed); }
+    void setRetention(std::size_t maxEntries);
+    void clearOldLogs(std::size_t amount);
+    std::vector<Log> getRecentLogs(std::size_t amount) const;
+    std::size_t getDroppedCount() const { return dropped_.load(std::memory_order_relaxed); }
+    std::size_t getTraceDroppedCount() const { return traceDropped_.load(std::memory_order_relaxed); }
+
+    bool startTrace(const std::filesystem::path& path);
+    void stopTrace();
+    bool isTracing() const { return tracing_.load(std::memory_order_relaxed); }
+    // no formatting, just a fixed size record. Returns the span id, 0 if tracing is off.
+    uint64_t trace(TraceEvent event, TracePhase phase, uint64_t arg = 0, uint64_t spanId = 0);
+};
+
+// Records BEGIN on construction and END on destruction. Fine to keep across co_await, the END may come from another thread.
+class TraceSpan {
+  private:
+    Logger& logger_;
+    TraceEvent event_;
+    uint64_t spanId_;
+    uint64_t endArg_ = 0;
+
+  public:
+    TraceSpan(Logger& cLogger, TraceEvent cEvent, uint64_t cArg = 0)
+        : logger_(cLogger), event_(cEvent), spanId_(cLogger.trace(cEvent, TracePhase::BEGIN, cArg)) {}
+    ~TraceSpan() {
+        if (spanId_ != 0) { logger_.trace(event_, TracePhase::END, endArg_, spanId_); }
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    void setEndArg(uint64_t arg) { endArg_ = arg; } // e.g. a result count only known once the span is done
+};
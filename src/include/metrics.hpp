@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Remove to compile every METRIC_* macro away
+#define WITH_METRICS
+
+enum class MetricKind : uint8_t { TIMER, COUNTER, HISTOGRAM };
+
+constexpr std::size_t MAX_METRICS = 128;
+constexpr std::size_t METRIC_BUCKET_COUNT = 32; // bucket i counts values below 2^i (nanoseconds for timers)
+constexpr std::size_t INVALID_METRIC = MAX_METRICS;
+
+struct MetricSnapshot {
+    std::string name;
+    MetricKind kind;
+    uint64_t count = 0;
+    uint64_t sum = 0; // nanoseconds for timers
+    uint64_t min = 0;
+    uint64_t max = 0;
+    std::array<uint64_t, METRIC_BUCKET_COUNT> buckets{};
+};
+
+// Every thread accumulates into its own shard, nothing is shared on the recording path. snapshot() sums the shards up.
+class Metrics {
+  public:
+    // ids are handed out once per call site (see the macros), names should be "<component>.<stage>"
+    static std::size_t registerMetric(const char* name, MetricKind kind);
+    static void record(std::size_t id, uint64_t value);
+    static std::vector<MetricSnapshot> snapshot();
+    static void reset();
+    static std::string toJson();
+    static bool exportJson(const std::filesystem::path& path);
+};
+
+class ScopedMetricTimer {
+  private:
+    std::size_t id_;
+    std::chrono::steady_clock::time_point start_;
+
+  public:
+    explicit ScopedMetricTimer(std::size_t cId) : id_(cId), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedMetricTimer() {
+        const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_);
+        Metrics::record(id_, static_cast<uint64_t>(elapsed.count()));
+    }
+    ScopedMetricTimer(const ScopedMetricTimer&) = delete;
+    ScopedMetricTimer& operator=(const ScopedMetricTimer&) = delete;
+};
+
+#define METRIC_CONCAT_INNER(a, b) a##b
+#define METRIC_CONCAT(a, b) METRIC_CONCAT_INNER(a, b)
+
+#ifdef WITH_METRICS
+// times the rest of the enclosing scope
+#define METRIC_TIMER(name)                                                                                                                 \
+    static const std::size_t METRIC_CONCAT(metricId_, __LINE__) = Metrics::registerMetric(name, MetricKind::TIMER);                       \
+    ScopedMetricTimer METRIC_CONCAT(metricTimer_, __LINE__) { METRIC_CONCAT(metricId_, __LINE__) }
+#define METRIC_COUNT(name, amount)                                                                                                         \
+    do {                                                                                                                                   \
+        static const std::size_t metricId = Metrics::registerMetric(name, MetricKind::COUNTER);                                           \
+        Metrics::record(metricId, static_cast<uint64_t>(amount));                                                                          \
+    } while (0)
+#define METRIC_OBSERVE(name, value)                                                                                                        \
+    do {                                                                                                                                   \
+        static const std::size_t metricId = Metrics::registerMetric(name, MetricKind::HISTOGRAM);                                         \
+        Metrics::record(metricId, static_cast<uint64_t>(value));                                                                           \
+    } while (0)
+#else
+#define METRIC_TIMER(name)
+#define METRIC_COUNT(name, amount)
+#define METRIC_OBSERVE(name, value)
+#endif
@@ -40,5 +40,7 @@ class PartApi {
     PartApi& operator=(PartApi&&) = delete;
 
     nlohmann::json fetchDataPoint(std::string dataPoint, bool forceRefetch = false);
-    void fetchExample(std::string dataPoint, UI::ApiPreviewState& state);
+    // runs fetchDataPoint on the io lane, the awaiting coroutine resumes there once the response is parsed
+    Task<nlohmann::json> fetchDataPointAsync(std::string dataPoint, TaskPriority priority, bool forceRefetch = false);
+    Task<void> fetchExample(std::string dataPoint, UI::ApiPreviewState& state);
 };
\ No newline at end of file
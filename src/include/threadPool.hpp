@@ -2,47 +2,329 @@
 
 #include "logger.hpp"
 
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <coroutine>
 #include <functional>
 #include <future>
 #include <mutex>
+#include <optional>
 #include <queue>
 #include <thread>
 #include <type_traits>
+#include <variant>
 #include <vector>
 
+// CPU: short, latency sensitive work (filtering, validation). IO: network and database bound work.
+enum class TaskLane : uint8_t { CPU, IO };
+enum class TaskPriority : uint8_t { HIGH, NORMAL, LOW };
+
+constexpr std::size_t LANE_COUNT = 2;
+constexpr std::size_t PRIORITY_COUNT = 3;
+constexpr std::size_t WAIT_BUCKET_COUNT = 16; // bucket i counts waits below 2^i microseconds, last bucket is open ended
+
+struct LaneStats {
+    std::size_t workers = 0;
+    std::size_t busy = 0;
+    std::size_t executed = 0;
+    std::array<std::size_t, PRIORITY_COUNT> queueDepth{};
+    std::array<std::size_t, WAIT_BUCKET_COUNT> waitHistogram{};
+};
+
+class ThreadPool;
+template <typename T> class Task;
+
+namespace TaskDetail {
+template <typename T> using Stored = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+template <typename T> struct State {
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::optional<Stored<T>> value;
+    std::exception_ptr error;
+    std::atomic<bool> done{false};
+    std::vector<std::function<void()>> continuations;
+    std::atomic<ThreadPool*> pool{nullptr}; // where continuations get scheduled
+
+    void finish(std::optional<Stored<T>> result, std::exception_ptr failure) {
+        std::vector<std::function<void()>> pending;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            value = std::move(result);
+            error = failure;
+            done.store(true, std::memory_order_release);
+            pending.swap(continuations);
+        }
+        cv.notify_all();
+        for (auto& continuation : pending) {
+            continuation();
+        }
+    }
+
+    // false if the state already finished, the continuation is not stored then
+    bool tryAddContinuation(std::function<void()>& continuation) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (done.load(std::memory_order_relaxed)) { return false; }
+        continuations.push_back(std::move(continuation));
+        return true;
+    }
+
+    void onDone(std::function<void()> continuation) {
+        if (!tryAddContinuation(continuation)) { continuation(); } // already finished, run right away
+    }
+};
+
+// runs f and stores its result or exception in state
+template <typename T, typename F> void fulfill(State<T>& state, F&& f) {
+    std::optional<Stored<T>> result;
+    std::exception_ptr error;
+    try {
+        if constexpr (std::is_void_v<T>) {
+            std::invoke(std::forward<F>(f));
+            result.emplace();
+        } else {
+            result.emplace(std::invoke(std::forward<F>(f)));
+        }
+    } catch (...) { error = std::current_exception(); }
+    state.finish(std::move(result), error);
+}
+
+template <typename T, typename F>
+using ContinuationResult =
+    typename std::conditional_t<std::is_void_v<T>, std::invoke_result<F>, std::invoke_result<F, Stored<T>&&>>::type;
+
+template <typename T> struct Awaiter {
+    std::shared_ptr<State<T>> state;
+
+    bool await_ready() const { return state->done.load(std::memory_order_acquire); }
+    template <typename P> bool await_suspend(std::coroutine_handle<P> handle) {
+        // the awaiting coroutine inherits the pool, so continuations chained onto it have somewhere to go
+        if constexpr (requires { handle.promise().bindPool(nullptr); }) {
+            if (ThreadPool* pool = state->pool.load()) { handle.promise().bindPool(pool); }
+        }
+        std::function<void()> resume = [handle] { handle.resume(); };
+        return state->tryAddContinuation(resume);
+    }
+    T await_resume() {
+        if (state->error) { std::rethrow_exception(state->error); }
+        if constexpr (!std::is_void_v<T>) { return std::move(*state->value); }
+    }
+};
+
+// Coroutines returning Task start eagerly and finish into the same State a spawned task would use
+template <typename T> struct PromiseBase {
+    std::shared_ptr<State<T>> state = std::make_shared<State<T>>();
+
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; } // the result lives on in state, the frame can go
+    void unhandled_exception() { state->finish(std::nullopt, std::current_exception()); }
+    void bindPool(ThreadPool* pool) {
+        ThreadPool* unbound = nullptr;
+        state->pool.compare_exchange_strong(unbound, pool);
+    }
+};
+
+template <typename T> struct Promise : PromiseBase<T> {
+    Task<T> get_return_object();
+    template <typename U> void return_value(U&& value) { this->state->finish(Stored<T>(std::forward<U>(value)), nullptr); }
+};
+
+template <> struct Promise<void> : PromiseBase<void> {
+    Task<void> get_return_object();
+    void return_void() { state->finish(std::monostate{}, nullptr); }
+};
+} // namespace TaskDetail
+
 class ThreadPool {
+  private:
+    struct QueuedTask {
+        std::function<void()> task;
+        std::chrono::steady_clock::time_point enqueued;
+    };
+
+    struct Lane {
+        std::array<std::queue<QueuedTask>, PRIORITY_COUNT> queues;
+        std::vector<std::thread> workers;
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::condition_variable cvHigh; // wakes the worker that is reserved for high priority tasks
+        std::array<std::atomic<std::size_t>, PRIORITY_COUNT> depth{};
+        std::array<std::atomic<std::size_t>, WAIT_BUCKET_COUNT> waitHistogram{};
+        std::atomic<std::size_t> busy{0};
+        std::atomic<std::size_t> executed{0};
+    };
+
   public:
-    ThreadPool(std::size_t cThreadCount, Logger& cLogger);
+    // co_await pool.schedule(lane, priority) continues the coroutine on a worker of that lane
+    struct ScheduleAwaiter {
+        ThreadPool* pool;
+        TaskLane lane;
+        TaskPriority priority;
+
+        bool await_ready() const noexcept { return false; }
+        template <typename P> void await_suspend(std::coroutine_handle<P> handle) {
+            if constexpr (requires { handle.promise().bindPool(pool); }) { handle.promise().bindPool(pool); }
+            pool->enqueue(lane, priority, [handle] { handle.resume(); });
+        }
+        void await_resume() const noexcept {}
+    };
+
+    ThreadPool(std::size_t cCpuThreadCount, std::size_t cIoThreadCount, Logger& cLogger);
     ~ThreadPool();
 
     // Submit any callable (including member functions)
     template <typename F, typename... Args> auto submit(F&& f, Args&&... args) {
+        return submitTo(TaskLane::CPU, TaskPriority::NORMAL, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    template <typename F, typename... Args> auto submitTo(TaskLane lane, TaskPriority priority, F&& f, Args&&... args) {
         using R = std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>;
         auto task = std::make_shared<std::packaged_task<R()>>(
             [f = std::forward<F>(f), ... args = std::forward<Args>(args)]() mutable { return std::invoke(f, std::move(args)...); });
 
         std::future<R> fut = task->get_future();
-
-        {
-            std::lock_guard<std::mutex> lock(mtx_);
-            tasks_.emplace([task] { (*task)(); });
-        }
-        cv_.notify_one();
+        enqueue(lane, priority, [task] { (*task)(); });
         return fut;
     }
 
-    std::size_t getAvailableThreadCount() const;
+    // Like submitTo, but returns a Task that further work can be chained onto instead of a future that has to be polled
+    template <typename F, typename... Args> auto spawn(TaskLane lane, TaskPriority priority, F&& f, Args&&... args);
+    // Completes once every task did; the results keep the order of the input
+    template <typename T> auto whenAll(std::vector<Task<T>> tasks);
+
+    ScheduleAwaiter schedule(TaskLane lane, TaskPriority priority) { return ScheduleAwaiter{this, lane, priority}; }
+
+    std::size_t getAvailableThreadCount(TaskLane lane = TaskLane::CPU) const;
+    LaneStats getLaneStats(TaskLane lane) const;
 
   private:
-    void workerLoop();
+    template <typename> friend class Task;
 
-    Logger& logger_;
-    std::vector<std::thread> workers_;
-    std::queue<std::function<void()>> tasks_;
+    void enqueue(TaskLane lane, TaskPriority priority, std::function<void()> task);
+    void workerLoop(Lane& lane, bool highOnly);
+    bool popTask(Lane& lane, bool highOnly, QueuedTask& out);
+    void recordWait(Lane& lane, std::chrono::steady_clock::duration wait);
 
-    std::mutex mtx_;
-    std::condition_variable cv_;
+    Logger& logger_;
+    std::array<Lane, LANE_COUNT> lanes_;
     std::atomic<bool> stopping_{false};
 };
+
+template <typename T> class Task {
+  private:
+    std::shared_ptr<TaskDetail::State<T>> state_;
+
+    friend class ThreadPool;
+
+  public:
+    using promise_type = TaskDetail::Promise<T>;
+
+    Task() = default;
+    explicit Task(std::shared_ptr<TaskDetail::State<T>> cState) : state_(std::move(cState)) {}
+
+    bool valid() const { return state_ != nullptr; }
+    bool isReady() const { return state_ && state_->done.load(std::memory_order_acquire); }
+
+    // Blocks until the result is there. Consumes the result, like std::future::get
+    T get() {
+        std::unique_lock<std::mutex> lock(state_->mtx);
+        state_->cv.wait(lock, [this] { return state_->done.load(std::memory_order_acquire); });
+        if (state_->error) { std::rethrow_exception(state_->error); }
+        if constexpr (!std::is_void_v<T>) { return std::move(*state_->value); }
+    }
+
+    // Suspends the awaiting coroutine until this task finished. It resumes on the thread that finished the task, hop lanes with
+    // ThreadPool::schedule if that matters.
+    TaskDetail::Awaiter<T> operator co_await() const { return TaskDetail::Awaiter<T>{state_}; }
+
+    // Schedules f with the result of this task as soon as it is available. Exceptions skip f and travel down the chain.
+    template <typename F> auto then(TaskLane lane, TaskPriority priority, F&& f) {
+        using R = TaskDetail::ContinuationResult<T, std::decay_t<F>>;
+        auto next = std::make_shared<TaskDetail::State<R>>();
+        next->pool.store(state_->pool.load());
+        state_->onDone([prev = state_, next, lane, priority, f = std::forward<F>(f)]() mutable {
+            auto run = [prev, next, f = std::move(f)]() mutable {
+                if (prev->error) {
+                    next->finish(std::nullopt, prev->error);
+                    return;
+                }
+                TaskDetail::fulfill(*next, [&]() -> R {
+                    if constexpr (std::is_void_v<T>) {
+                        return std::invoke(f);
+                    } else {
+                        return std::invoke(f, std::move(*prev->value));
+                    }
+                });
+            };
+            // coroutines that never touched a pool have nowhere to schedule to, they continue inline
+            ThreadPool* pool = prev->pool.load();
+            if (!pool) {
+                run();
+                return;
+            }
+            next->pool.store(pool);
+            pool->enqueue(lane, priority, std::move(run));
+        });
+        return Task<R>(next);
+    }
+};
+
+template <typename T> Task<T> TaskDetail::Promise<T>::get_return_object() {
+    return Task<T>(this->state);
+}
+
+inline Task<void> TaskDetail::Promise<void>::get_return_object() {
+    return Task<void>(state);
+}
+
+template <typename F, typename... Args> auto ThreadPool::spawn(TaskLane lane, TaskPriority priority, F&& f, Args&&... args) {
+    using R = std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>;
+    auto state = std::make_shared<TaskDetail::State<R>>();
+    state->pool = this;
+    enqueue(lane, priority, [state, f = std::forward<F>(f), ... args = std::forward<Args>(args)]() mutable {
+        TaskDetail::fulfill(*state, [&]() -> R { return std::invoke(f, std::move(args)...); });
+    });
+    return Task<R>(state);
+}
+
+template <typename T> auto ThreadPool::whenAll(std::vector<Task<T>> tasks) {
+    using R = std::conditional_t<std::is_void_v<T>, void, std::vector<T>>;
+    auto next = std::make_shared<TaskDetail::State<R>>();
+    next->pool = this;
+    if (tasks.empty()) {
+        TaskDetail::fulfill(*next, []() -> R { return R(); });
+        return Task<R>(next);
+    }
+
+    auto remaining = std::make_shared<std::atomic<std::size_t>>(tasks.size());
+    auto states = std::make_shared<std::vector<std::shared_ptr<TaskDetail::State<T>>>>();
+    states->reserve(tasks.size());
+    for (Task<T>& task : tasks) {
+        states->push_back(task.state_);
+    }
+    for (auto& state : *states) {
+        // the last task to finish assembles the result on its own thread, no extra hop through the queue
+        state->onDone([remaining, states, next] {
+            if (remaining->fetch_sub(1, std::memory_order_acq_rel) != 1) { return; }
+            for (const auto& s : *states) {
+                if (s->error) {
+                    next->finish(std::nullopt, s->error);
+                    return;
+                }
+            }
+            TaskDetail::fulfill(*next, [&]() -> R {
+                if constexpr (!std::is_void_v<T>) {
+                    R values;
+                    values.reserve(states->size());
+                    for (auto& s : *states) {
+                        values.push_back(std::move(*s->value));
+                    }
+                    return values;
+                }
+            });
+        });
+    }
+    return Task<R>(next);
+}
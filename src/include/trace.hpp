@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+// Binary trace format, shared between Logger (writer) and tools/traceToChrome (reader).
+// File: TRACE_MAGIC followed by fixed size TraceRecords, native byte order.
+
+enum class TraceEvent : uint16_t { IMPORT_READ, IMPORT_EXECUTE, API_FETCH, FILTER, CHANGE_APPLY, DB_LOAD, IMPORT_PREPARE, COUNT };
+enum class TracePhase : uint8_t { BEGIN, END, INSTANT };
+
+constexpr std::array<char, 8> TRACE_MAGIC{'I', 'M', 'T', 'R', 'A', 'C', 'E', '1'};
+
+struct TraceRecord {
+    uint64_t timestampNs; // steady clock
+    uint64_t spanId;      // pairs BEGIN with END, spans of coroutines can end on another thread
+    uint64_t arg;         // event specific, e.g. row or change count
+    uint32_t threadId;
+    TraceEvent event;
+    TracePhase phase;
+    uint8_t padding = 0;
+};
+static_assert(sizeof(TraceRecord) == 32);
+
+constexpr std::string_view traceEventName(TraceEvent event) {
+    switch (event) {
+    case TraceEvent::IMPORT_READ:
+        return "import.read";
+    case TraceEvent::IMPORT_EXECUTE:
+        return "import.execute";
+    case TraceEvent::API_FETCH:
+        return "import.apiFetch";
+    case TraceEvent::FILTER:
+        return "filter";
+    case TraceEvent::CHANGE_APPLY:
+        return "execute.changes";
+    case TraceEvent::DB_LOAD:
+        return "db.load";
+    case TraceEvent::IMPORT_PREPARE:
+        return "import.prepare";
+    default:
+        return "unknown";
+    }
+}
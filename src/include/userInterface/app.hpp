@@ -9,6 +9,7 @@
 #include "dbFilter.hpp"
 #include "dbService.hpp"
 #include "logger.hpp"
+#include "metrics.hpp"
 
 #include "dataTypes.hpp"
 #include "userInterface/autoInvVisualizer.hpp"
@@ -42,7 +43,7 @@ class App {
     std::shared_ptr<const CompleteDbData> filteredDbData_; // copy of data for simplicity and thread safety
     bool filterActive_ = false;
     std::array<char, UI::BUFFER_SIZE> filterBuffer_;
-    std::shared_ptr<uiChangeInfo> uiChanges_;
+    std::shared_ptr<const uiChangeInfo> uiChanges_;
 
     bool waitForDbData() {
         if (dataStates_.dbData == UI::DataState::DATA_READY) { return false; }
@@ -59,7 +60,11 @@ class App {
         dbFilter_.setData(dbData_);
 
         changeTracker_.setMaxPKeys(dbData_->maxPKeys);
-        if (!uiChanges_) { uiChanges_ = std::make_shared<uiChangeInfo>(); }
+        if (!uiChanges_) {
+            // first snapshot, what the previous session left pending comes back checked against it
+            if (!config_.getPendingChangesPath().empty()) { changeTracker_.openChangeLog(config_.getPendingChangesPath()); }
+            uiChanges_ = std::make_shared<uiChangeInfo>();
+        }
 
         return true;
     }
@@ -94,7 +99,7 @@ class App {
             break;
         case UI::DataState::DATA_OUTDATED: {
             dbService_.refetch();
-            uiChanges_ = std::make_shared<uiChangeInfo>(changeTracker_.getSnapShot());
+            uiChanges_ = changeTracker_.getSnapShot();
             dbVisualizer_.setChangeData(uiChanges_);
             dataStates_.dbData = UI::DataState::WAITING_FOR_DATA;
             break;
@@ -102,9 +107,13 @@ class App {
         case UI::DataState::WAITING_FOR_DATA:
             if (waitForDbData()) { dataStates_.dbData = UI::DataState::DATA_READY; }
             break;
-        case UI::DataState::DATA_READY:
-            uiChanges_ = std::make_shared<uiChangeInfo>(changeTracker_.getSnapShot());
-            dbVisualizer_.setChangeData(uiChanges_);
+        case UI::DataState::DATA_READY: {
+            // same pointer as long as nothing changed, the widgets keep theirs
+            std::shared_ptr<const uiChangeInfo> snapshot = changeTracker_.getSnapShot();
+            if (snapshot != uiChanges_) {
+                uiChanges_ = std::move(snapshot);
+                dbVisualizer_.setChangeData(uiChanges_);
+            }
             if (changeExe_.isChangeApplicationDone()) {
                 changeExe_.getSuccessfulChanges();
                 dataStates_.dbData = UI::DataState::DATA_OUTDATED;
@@ -115,6 +124,7 @@ class App {
                 dbVisualizer_.setData(filteredDbData_); // gets filtered data
             }
             break;
+        }
         default:
             break;
         }
@@ -241,6 +251,54 @@ class App {
         ImGui::Columns(1);
     }
 
+    void showMetrics() {
+        if (ImGui::Button("RESET")) { Metrics::reset(); }
+        ImGui::SameLine();
+        if (ImGui::Button("EXPORT JSON")) {
+            const std::filesystem::path path = config_.getExeDir() / "metrics.json";
+            if (Metrics::exportJson(path)) {
+                logger_.pushLog(Log{std::format("SUCCESS: Exported metrics to {}.", path.string())});
+            } else {
+                logger_.pushLog(Log{std::format("ERROR: Could not export metrics to {}.", path.string())});
+            }
+        }
+
+        ImGui::Columns(6, "MetricColumns", true);
+        for (const char* header : {"Metric", "Count", "Total", "Mean", "Min", "Max"}) {
+            ImGui::TextUnformatted(header);
+            ImGui::NextColumn();
+        }
+        ImGui::Separator();
+
+        for (const MetricSnapshot& metric : Metrics::snapshot()) {
+            ImGui::TextUnformatted(metric.name.c_str());
+            ImGui::NextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(metric.count));
+            ImGui::NextColumn();
+            const double mean = metric.count > 0 ? static_cast<double>(metric.sum) / static_cast<double>(metric.count) : 0.0;
+            if (metric.kind == MetricKind::TIMER) {
+                // recorded in nanoseconds
+                ImGui::Text("%.3f ms", static_cast<double>(metric.sum) / 1e6);
+                ImGui::NextColumn();
+                ImGui::Text("%.3f ms", mean / 1e6);
+                ImGui::NextColumn();
+                ImGui::Text("%.3f ms", static_cast<double>(metric.min) / 1e6);
+                ImGui::NextColumn();
+                ImGui::Text("%.3f ms", static_cast<double>(metric.max) / 1e6);
+            } else {
+                ImGui::Text("%llu", static_cast<unsigned long long>(metric.sum));
+                ImGui::NextColumn();
+                ImGui::Text("%.2f", mean);
+                ImGui::NextColumn();
+                ImGui::Text("%llu", static_cast<unsigned long long>(metric.min));
+                ImGui::NextColumn();
+                ImGui::Text("%llu", static_cast<unsigned long long>(metric.max));
+            }
+            ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+    }
+
   public:
     App(Config& cConfig,
         ThreadPool& cPool,
@@ -271,8 +329,8 @@ class App {
         orderVisualizer_.setDefaultPath(config_.getCsvPathOrder());
 
         AutoInv::LoadedMappings loaded = config_.readMappings();
-        pool_.submit(AutoInv::BomVisualizer::injectMappings, &bomVisualizer_, loaded.bom);
-        pool_.submit(AutoInv::OrderVisualizer::injectMappings, &orderVisualizer_, loaded.order);
+        pool_.submitTo(TaskLane::CPU, TaskPriority::LOW, AutoInv::BomVisualizer::injectMappings, &bomVisualizer_, loaded.bom);
+        pool_.submitTo(TaskLane::CPU, TaskPriority::LOW, AutoInv::OrderVisualizer::injectMappings, &orderVisualizer_, loaded.order);
     }
 
     void run() {
@@ -300,6 +358,10 @@ class App {
                     showHistory();
                     ImGui::EndTabItem();
                 }
+                if (ImGui::BeginTabItem("Metrics")) {
+                    showMetrics();
+                    ImGui::EndTabItem();
+                }
                 ImGui::EndTabBar();
             }
 
@@ -31,7 +31,7 @@ class DbVisualizer {
 
     std::shared_ptr<const CompleteDbData> dbData_;
 
-    std::shared_ptr<uiChangeInfo> uiChanges_;
+    std::shared_ptr<const uiChangeInfo> uiChanges_;
     EditingData edit_;
     std::string selectedTable_;
     std::unordered_set<std::size_t> changeHighlight_;
@@ -45,10 +45,18 @@ class DbVisualizer {
         ImGui::Text("CHANGE OVERVIEW");
         ImGui::BeginDisabled(dataStates_.dbData != UI::DataState::DATA_READY);
         if (ImGui::Button("Execute all")) { changeExe_.requestChangeApplication(SqlAction::EXECUTE); }
+        ImGui::SameLine();
+        ImGui::BeginDisabled(!changeTracker_.canUndo());
+        if (ImGui::Button("Undo")) { changeTracker_.undo(); }
+        ImGui::EndDisabled();
+        ImGui::SameLine();
+        ImGui::BeginDisabled(!changeTracker_.canRedo());
+        if (ImGui::Button("Redo")) { changeTracker_.redo(); }
+        ImGui::EndDisabled();
 
         for (const std::size_t rootKey : uiChanges_->roots) {
             std::size_t depth = 0;
-            const Change& change = uiChanges_->changes.at(rootKey);
+            const Change& change = uiChanges_->getChange(rootKey);
             ImVec2 beginning = ImGui::GetCursorScreenPos();
             ImVec2 end = drawChangesTree(change, &depth, INVALID_ID);
             ImDrawList* drawlist = ImGui::GetWindowDrawList();
@@ -78,7 +86,7 @@ class DbVisualizer {
             (*treeDepth)++;
             const std::vector<std ::size_t>& children = change.getChildren();
             for (std::size_t childKey : children) {
-                position = drawChangesTree(uiChanges_->changes.at(childKey), treeDepth, key);
+                position = drawChangesTree(uiChanges_->getChange(childKey), treeDepth, key);
             }
             (*treeDepth)--;
         }
@@ -90,7 +98,7 @@ class DbVisualizer {
     }
 
     Widgets::MouseEventType drawChange(const std::size_t key, std::size_t* visualDepth, const std::size_t parent, ImVec2& position) {
-        const Change& change = uiChanges_->changes.at(key);
+        const Change& change = uiChanges_->getChange(key);
         return changeOverviewer_.drawSingleChangeOverview(change, visualDepth, parent, position);
     }
 
@@ -110,16 +118,21 @@ class DbVisualizer {
                 if (it != header.end()) { selectedTable_ = it->referencedTable; }
                 break;
             }
-            case Widgets::ActionType::REMOVE:
-                changeTracker_.addChange(Change(Change::colValMap{},
-                                                ChangeType::DELETE_ROW,
-                                                dbService_.getTable(event.tableName),
-                                                static_cast<std::size_t>(std::stoi(event.pKey))));
+            case Widgets::ActionType::REMOVE: {
+                Change change(Change::colValMap{},
+                              ChangeType::DELETE_ROW,
+                              dbService_.getTable(event.tableName),
+                              static_cast<std::size_t>(std::stoi(event.pKey)));
+                dbService_.captureExpectedCells(change, dbService_.findIndexOfPKey(event.tableName, event.pKey));
+                changeTracker_.addChange(std::move(change));
                 break;
-            case Widgets::ActionType::EDIT:
-                changeTracker_.addChange(Change(tableEvent.cells, ChangeType::UPDATE_CELLS, dbService_.getTable(event.tableName)),
-                                         static_cast<std::size_t>(std::stoi(event.pKey)));
+            }
+            case Widgets::ActionType::EDIT: {
+                Change change(tableEvent.cells, ChangeType::UPDATE_CELLS, dbService_.getTable(event.tableName));
+                dbService_.captureExpectedCells(change, dbService_.findIndexOfPKey(event.tableName, event.pKey));
+                changeTracker_.addChange(std::move(change), static_cast<std::size_t>(std::stoi(event.pKey)));
                 break;
+            }
             case Widgets::ActionType::REQUEST_EDIT: {
                 const std::size_t pKeyId = static_cast<std::size_t>(std::stoi(event.pKey));
                 if (edit_.whichId == pKeyId) {
@@ -173,7 +186,7 @@ class DbVisualizer {
         dbTable_.setData(newData);
     }
 
-    void setChangeData(std::shared_ptr<uiChangeInfo> changeData) {
+    void setChangeData(std::shared_ptr<const uiChangeInfo> changeData) {
         uiChanges_ = changeData;
         dbTable_.setChangeData(changeData);
         changeOverviewer_.setChangeData(changeData);
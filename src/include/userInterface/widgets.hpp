@@ -71,7 +71,7 @@ concept drawFunction = std::invocable<F, const CellInfo&, const Rect&, Args...>;
 class DbTable {
   private:
     std::shared_ptr<const CompleteDbData> dbData_;
-    std::shared_ptr<uiChangeInfo> uiChanges_;
+    std::shared_ptr<const uiChangeInfo> uiChanges_;
     std::unique_ptr<Change> rowChange_;
 
     EditingData& edit_;
@@ -135,7 +135,7 @@ class DbTable {
 
     // Draw overlay for inserted/updated cell values for given Change
     void drawChangeOverlayIfNeeded(
-        Change* ch, const std::string& originalValue, const std::string& headerName, const Rect& r, const EventTypes& event);
+        const Change* ch, const std::string& originalValue, const std::string& headerName, const Rect& r, const EventTypes& event);
     EventTypes drawLastColumnEnter(const ImVec2& pos, const std::vector<float>& splitterPoss, const std::size_t columnIndex);
     EventTypes
     drawActionColumn(const ImVec2& pos, const std::vector<float>& splitterPoss, const std::size_t columnIndex, const Change* change);
@@ -193,7 +193,7 @@ class DbTable {
 
     void drawTable(const std::string& tableName);
     void setData(std::shared_ptr<const CompleteDbData> newData);
-    void setChangeData(std::shared_ptr<uiChangeInfo> changeData);
+    void setChangeData(std::shared_ptr<const uiChangeInfo> changeData);
     Event getEvent() const;
     void popEvent();
 };
@@ -202,7 +202,7 @@ class ChangeOverviewer {
   private:
     ChangeTracker& changeTracker;
     ChangeExeService& changeExe;
-    std::shared_ptr<uiChangeInfo> uiChanges;
+    std::shared_ptr<const uiChangeInfo> uiChanges;
     float childWidth;
     float hPadding;
     std::unordered_set<std::size_t>& changeHighlight;
@@ -225,7 +225,7 @@ class ChangeOverviewer {
         : changeTracker(cChangeTracker), changeExe(cChangeExe), childWidth(cChildWidth), changeHighlight(cChangeHighlight),
           selectedTable(cSelectedTable) {}
 
-    void setChangeData(std::shared_ptr<uiChangeInfo> changeData);
+    void setChangeData(std::shared_ptr<const uiChangeInfo> changeData);
     bool drawChildren(const std::vector<std::size_t>& children, float allowedWidth);
     MouseEventType drawSingleChangeOverview(const Change& change, std::size_t* visualDepth, const std::size_t parent, ImVec2& position);
 };
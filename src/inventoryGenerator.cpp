@@ -0,0 +1,320 @@
+#include "inventoryGenerator.hpp"
+#include "autoInv.hpp"
+
+#include <array>
+#include <fstream>
+#include <random>
+
+namespace {
+constexpr std::array<const char*, 10> TABLE_NAMES{
+    "manufacturers", "footprints", "locations", "suppliers", "categories", "packages", "series", "vendors", "storages", "projects"};
+constexpr std::array<const char*, 16> WORDS{"resistor",
+                                            "capacitor",
+                                            "inductor",
+                                            "diode",
+                                            "mosfet",
+                                            "connector",
+                                            "smd",
+                                            "tht",
+                                            "0402",
+                                            "0805",
+                                            "sot-23",
+                                            "10k",
+                                            "100n",
+                                            "ceramic",
+                                            "x7r",
+                                            "tantal"};
+constexpr std::array<const char*, 6> DESIGNATORS{"R", "C", "L", "D", "Q", "J"};
+
+// std distributions differ between standard libraries, plain modulo keeps the output identical everywhere
+class Random {
+  private:
+    std::mt19937 engine_;
+
+  public:
+    explicit Random(uint32_t seed) : engine_(seed) {}
+    std::size_t below(std::size_t bound) { return bound == 0 ? 0 : engine_() % bound; }
+    bool chance(double share) { return below(1000000) < static_cast<std::size_t>(share * 1000000); }
+    std::string description() {
+        return std::format("{} {} {}", WORDS[below(WORDS.size())], WORDS[below(WORDS.size())], WORDS[below(WORDS.size())]);
+    }
+};
+
+std::string tableName(std::size_t index) {
+    const std::string base = TABLE_NAMES[index % TABLE_NAMES.size()];
+    return index < TABLE_NAMES.size() ? base : std::format("{}{}", base, index / TABLE_NAMES.size());
+}
+
+std::string rowName(const std::string& table, std::size_t index) {
+    return std::format("{}-{:05}", table, index + 1);
+}
+
+std::string fkColumn(const std::string& referencedTable) {
+    return referencedTable + "_id";
+}
+
+const char* sqlType(DB::DataType type) {
+    switch (type) {
+    case DB::DataType::INT32:
+        return "integer";
+    case DB::DataType::STRING:
+        return "varchar(64)";
+    default:
+        return "text";
+    }
+}
+
+std::string copyEscape(const std::string& value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (char c : value) {
+        switch (c) {
+        case '\\':
+            escaped += "\\\\";
+            break;
+        case '\t':
+            escaped += "\\t";
+            break;
+        case '\n':
+            escaped += "\\n";
+            break;
+        default:
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+} // namespace
+
+InventoryGenerator::InventoryGenerator(GeneratorOptions cOptions) : options_(cOptions) {
+    // referencing tables need a row to point at, without one every foreign key names a row that does not exist
+    if (options_.depth > 0 && options_.fanout == 0) { options_.fanout = 1; }
+    if (options_.depth > 0 && options_.rowsPerTable == 0) { options_.rowsPerTable = 1; }
+    generateTables();
+    generateCsvs();
+}
+
+std::string InventoryGenerator::partNumber(std::size_t index) const {
+    return std::format("PN{:07}", index + 1);
+}
+
+void InventoryGenerator::generateTables() {
+    Random random{options_.seed};
+
+    // leaves first, so every table only references tables generated before it
+    std::vector<std::string> previousLevel;
+    for (std::size_t level = 0; level <= options_.depth; ++level) {
+        const bool isTop = level == options_.depth;
+        std::vector<std::string> currentLevel;
+        for (std::size_t i = 0; i < (isTop ? 1 : options_.fanout); ++i) {
+            // named from the top, parts always references manufacturers, footprints, locations, ...
+            currentLevel.push_back(isTop ? PARTS_TABLE : tableName((options_.depth - 1 - level) * options_.fanout + i));
+        }
+
+        for (const std::string& table : currentLevel) {
+            const std::size_t rowCount = isTop ? options_.parts : options_.rowsPerTable;
+            HeadersInfo headers;
+            headers.pkey = "id";
+            headers.uKeyName = "name";
+            headers.maxDepth = level;
+            headers.data.push_back(HeaderInfo{"id", "", DB::HeaderTypes::PRIMARY_KEY, DB::DataType::INT32, 0, false});
+            headers.data.push_back(HeaderInfo{"name", "", DB::HeaderTypes::UNIQUE_KEY, DB::DataType::STRING, 0, false});
+            headers.data.push_back(HeaderInfo{"description", "", DB::HeaderTypes::DATA, DB::DataType::TEXT, 0, true});
+            if (isTop) { headers.data.push_back(HeaderInfo{QUANTITY_COLUMN, "", DB::HeaderTypes::DATA, DB::DataType::INT32, 0, false}); }
+            for (const std::string& referenced : previousLevel) {
+                headers.data.push_back(
+                    HeaderInfo{fkColumn(referenced), referenced, DB::HeaderTypes::FOREIGN_KEY, DB::DataType::INT32, level, true});
+            }
+
+            ColumnDataMap columns;
+            for (const HeaderInfo& header : headers.data) {
+                columns[header.name].reserve(rowCount);
+            }
+            for (std::size_t r = 0; r < rowCount; ++r) {
+                columns["id"].push_back(std::to_string(r + 1));
+                columns["name"].push_back(isTop ? partNumber(r) : rowName(table, r));
+                columns["description"].push_back(random.description());
+                if (isTop) { columns[QUANTITY_COLUMN].push_back(std::to_string(random.below(5000))); }
+                for (const std::string& referenced : previousLevel) {
+                    columns[fkColumn(referenced)].push_back(std::to_string(random.below(options_.rowsPerTable) + 1));
+                }
+            }
+
+            data_.tables.push_back(table);
+            data_.headers.emplace(table, std::move(headers));
+            data_.tableRows.emplace(table, std::move(columns));
+            data_.maxPKeys[table] = rowCount;
+        }
+        previousLevel = std::move(currentLevel);
+    }
+}
+
+void InventoryGenerator::generateCsvs() {
+    Random random{options_.seed + 1};
+    const HeadersInfo& partHeaders = data_.headers.at(PARTS_TABLE);
+    const ColumnDataMap& parts = data_.tableRows.at(PARTS_TABLE);
+    std::vector<std::string> referencedTables;
+    for (const HeaderInfo& header : partHeaders.data) {
+        if (header.type == DB::HeaderTypes::FOREIGN_KEY) { referencedTables.push_back(header.referencedTable); }
+    }
+
+    // existing parts keep their description, new ones get numbers past the generated range
+    auto pickPart = [&](std::size_t& index) {
+        const bool isNew = options_.parts == 0 || random.chance(options_.newPartShare);
+        index = isNew ? options_.parts + random.below(std::max<std::size_t>(options_.parts, 1)) : random.below(options_.parts);
+        return isNew;
+    };
+
+    // BOM: what a cad export looks like, references named by their unique key like mappings expect them
+    std::vector<std::string> bomHeader{"Designator", "Part Number", "Quantity", "Description"};
+    bomHeader.insert(bomHeader.end(), referencedTables.begin(), referencedTables.end());
+    bom_.rows.push_back(std::move(bomHeader));
+    for (std::size_t r = 0; r < options_.bomRows; ++r) {
+        std::size_t index = 0;
+        const bool isNew = pickPart(index);
+        std::vector<std::string> row{std::format("{}{}", DESIGNATORS[random.below(DESIGNATORS.size())], r + 1),
+                                     partNumber(index),
+                                     std::to_string(random.below(20) + 1),
+                                     isNew ? random.description() : parts.at("description")[index]};
+        for (const std::string& referenced : referencedTables) {
+            row.push_back(rowName(referenced, random.below(options_.rowsPerTable)));
+        }
+        bom_.rows.push_back(std::move(row));
+    }
+
+    // order: a distributor export, the manufacturer part number is what the api gets asked for
+    const std::string manufacturerTable = referencedTables.empty() ? std::string{} : referencedTables.front();
+    apiArchive_ = nlohmann::json::object();
+    order_.rows.push_back({"Mouser No", "Mfr. No", "Description", "Order Qty.", "Price (EUR)"});
+    for (std::size_t r = 0; r < options_.orderRows; ++r) {
+        std::size_t index = 0;
+        const bool isNew = pickPart(index);
+        const std::string number = partNumber(index);
+        const std::string description = isNew ? random.description() : parts.at("description")[index];
+        order_.rows.push_back({std::format("81-{}", number),
+                               number,
+                               description,
+                               std::to_string(random.below(500) + 1),
+                               std::format("{}.{:02}", random.below(100), random.below(100))});
+
+        if (apiArchive_.contains(number)) { continue; }
+        std::string manufacturer;
+        if (!manufacturerTable.empty()) {
+            // existing parts report the manufacturer they reference
+            const std::size_t row =
+                isNew ? random.below(options_.rowsPerTable) : std::stoul(parts.at(fkColumn(manufacturerTable))[index]) - 1;
+            manufacturer = rowName(manufacturerTable, row);
+        }
+        nlohmann::json part{{"MouserPartNumber", std::format("81-{}", number)},
+                            {"ManufacturerPartNumber", number},
+                            {"Manufacturer", manufacturer},
+                            {"Description", description},
+                            {"Category", WORDS[random.below(WORDS.size())]},
+                            {"Availability", std::format("{} In Stock", random.below(100000))}};
+        apiArchive_[number] = nlohmann::json{{"Errors", nlohmann::json::array()},
+                                             {"SearchResults", {{"NumberOfResult", 1}, {"Parts", nlohmann::json::array({part})}}}};
+    }
+}
+
+const GeneratorOptions& InventoryGenerator::getOptions() const {
+    return options_;
+}
+
+const CompleteDbData& InventoryGenerator::getData() const {
+    return data_;
+}
+
+const CSV::Data& InventoryGenerator::getBom() const {
+    return bom_;
+}
+
+const CSV::Data& InventoryGenerator::getOrder() const {
+    return order_;
+}
+
+const nlohmann::json& InventoryGenerator::getApiArchive() const {
+    return apiArchive_;
+}
+
+void InventoryGenerator::writeSchemaSql(std::ostream& out) const {
+    out << std::format("-- synthetic inventory, seed {}, depth {}, fanout {}\n\n", options_.seed, options_.depth, options_.fanout);
+    out << "DROP TABLE IF EXISTS";
+    for (auto it = data_.tables.rbegin(); it != data_.tables.rend(); ++it) {
+        out << (it == data_.tables.rbegin() ? " " : ", ") << *it;
+    }
+    out << " CASCADE;\n";
+
+    for (const std::string& table : data_.tables) {
+        out << std::format("\nCREATE TABLE {} (", table);
+        const HeaderVector& headers = data_.headers.at(table).data;
+        for (std::size_t i = 0; i < headers.size(); ++i) {
+            const HeaderInfo& header = headers[i];
+            out << std::format("{}\n    {} {}", i == 0 ? "" : ",", header.name, sqlType(header.dataType));
+            switch (header.type) {
+            case DB::HeaderTypes::PRIMARY_KEY:
+                out << " GENERATED BY DEFAULT AS IDENTITY PRIMARY KEY";
+                break;
+            case DB::HeaderTypes::UNIQUE_KEY:
+                out << " UNIQUE";
+                break;
+            case DB::HeaderTypes::FOREIGN_KEY:
+                out << std::format(" REFERENCES {} (id)", header.referencedTable);
+                break;
+            default:
+                break;
+            }
+            if (!header.nullable && header.type != DB::HeaderTypes::PRIMARY_KEY) { out << " NOT NULL"; }
+        }
+        out << "\n);\n";
+    }
+}
+
+void InventoryGenerator::writeDataSql(std::ostream& out) const {
+    out << "BEGIN;\n";
+    for (const std::string& table : data_.tables) {
+        const HeaderVector& headers = data_.headers.at(table).data;
+        const ColumnDataMap& columns = data_.tableRows.at(table);
+        const std::size_t rowCount = data_.maxPKeys.at(table);
+
+        out << std::format("\nCOPY {} (", table);
+        for (std::size_t i = 0; i < headers.size(); ++i) {
+            out << (i == 0 ? "" : ", ") << headers[i].name;
+        }
+        out << ") FROM stdin;\n";
+        for (std::size_t r = 0; r < rowCount; ++r) {
+            for (std::size_t i = 0; i < headers.size(); ++i) {
+                out << (i == 0 ? "" : "\t") << copyEscape(columns.at(headers[i].name)[r]);
+            }
+            out << '\n';
+        }
+        out << "\\.\n";
+        if (rowCount > 0) { out << std::format("SELECT setval(pg_get_serial_sequence('{}', 'id'), {});\n", table, rowCount); }
+    }
+    out << "\nCOMMIT;\n";
+}
+
+bool InventoryGenerator::writeFiles(const std::filesystem::path& directory, Logger& logger) const {
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) {
+        logger.pushLog(Log{std::format("ERROR: Could not create {}: {}", directory.string(), ec.message())});
+        return false;
+    }
+
+    auto writeFile = [&](const std::string& name, auto&& write) {
+        std::ofstream out(directory / name);
+        if (!out) {
+            logger.pushLog(Log{std::format("ERROR: Could not write {}", (directory / name).string())});
+            return false;
+        }
+        write(out);
+        return static_cast<bool>(out);
+    };
+
+    bool success = writeFile("schema.sql", [this](std::ostream& out) { writeSchemaSql(out); });
+    success = success && writeFile("data.sql", [this](std::ostream& out) { writeDataSql(out); });
+    success = success && writeFile("apiArchive.json", [this](std::ostream& out) { out << apiArchive_.dump(); });
+    success = success && writeData(directory / "bom.csv", bom_, logger);
+    success = success && writeData(directory / "order.csv", order_, logger);
+    return success;
+}
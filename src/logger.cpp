@@ -0,0 +1,141 @@
+#include "logger.hpp"
+
+#include <algorithm>
+
+namespace {
+constexpr std::chrono::milliseconds FLUSH_INTERVAL{10};
+
+uint32_t currentTraceThread() {
+    static std::atomic<uint32_t> nextId{0};
+    thread_local const uint32_t id = nextId.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+} // namespace
+
+Logger::Logger() {
+    flusher_ = std::thread(&Logger::flushLoop, this);
+}
+
+Logger::~Logger() {
+    stopping_.store(true, std::memory_order_release);
+    if (flusher_.joinable()) { flusher_.join(); }
+    stopTrace();
+}
+
+void Logger::pushLog(Log log) {
+    if (!isEnabled(log.getLevel())) { return; }
+    if (!ring_.tryPush(std::move(log))) { dropped_.fetch_add(1, std::memory_order_relaxed); }
+}
+
+void Logger::flushLoop() {
+    while (!stopping_.load(std::memory_order_acquire)) {
+        drain();
+        drainTrace();
+        std::this_thread::sleep_for(FLUSH_INTERVAL);
+    }
+    // whatever got pushed before shutdown
+    drain();
+    drainTrace();
+}
+
+void Logger::drain() {
+    std::vector<Log> batch;
+    Log log;
+    while (ring_.tryPop(log)) {
+        batch.push_back(std::move(log));
+    }
+    const std::size_t dropped = dropped_.load(std::memory_order_relaxed);
+    if (dropped != reportedDropped_) {
+        batch.emplace_back(LogLevel::WARN, std::format("WARNING: Log buffer was full, dropped {} entries.", dropped - reportedDropped_));
+        reportedDropped_ = dropped;
+    }
+    if (batch.empty()) { return; }
+
+#ifdef WITH_LOGGING
+    // one write per batch instead of one per message
+    std::string out;
+    for (const Log& entry : batch) {
+        entry.print(out);
+    }
+    std::cout << out << std::flush;
+#endif
+
+    std::lock_guard<std::mutex> lock(historyMtx_);
+    for (Log& entry : batch) {
+        history_.push_back(std::move(entry));
+    }
+    if (history_.size() > retention_) { history_.erase(history_.begin(), history_.begin() + (history_.size() - retention_)); }
+}
+
+void Logger::setRetention(std::size_t maxEntries) {
+    std::lock_guard<std::mutex> lock(historyMtx_);
+    retention_ = maxEntries;
+    if (history_.size() > retention_) { history_.erase(history_.begin(), history_.begin() + (history_.size() - retention_)); }
+}
+
+void Logger::clearOldLogs(std::size_t amount) {
+    std::lock_guard<std::mutex> lock(historyMtx_);
+    history_.erase(history_.begin(), history_.begin() + std::min(amount, history_.size()));
+}
+
+std::vector<Log> Logger::getRecentLogs(std::size_t amount) const {
+    std::lock_guard<std::mutex> lock(historyMtx_);
+    const std::size_t count = std::min(amount, history_.size());
+    return std::vector<Log>(history_.end() - count, history_.end());
+}
+
+bool Logger::startTrace(const std::filesystem::path& path) {
+    {
+        std::lock_guard<std::mutex> lock(traceMtx_);
+        if (traceFile_.is_open()) { traceFile_.close(); }
+        traceFile_.open(path, std::ios::binary | std::ios::trunc);
+        if (!traceFile_) {
+            tracing_.store(false, std::memory_order_relaxed);
+        } else {
+            traceFile_.write(TRACE_MAGIC.data(), TRACE_MAGIC.size());
+            tracing_.store(true, std::memory_order_relaxed);
+        }
+    }
+    if (!isTracing()) {
+        pushLog(Log{std::format("ERROR: Could not open trace file {}.", path.string())});
+        return false;
+    }
+    pushLog(Log{std::format("Tracing to {}.", path.string())});
+    return true;
+}
+
+void Logger::stopTrace() {
+    tracing_.store(false, std::memory_order_relaxed);
+    drainTrace();
+    std::lock_guard<std::mutex> lock(traceMtx_);
+    if (traceFile_.is_open()) { traceFile_.close(); }
+}
+
+uint64_t Logger::trace(TraceEvent event, TracePhase phase, uint64_t arg, uint64_t spanId) {
+    if (!isTracing()) { return 0; }
+    if (spanId == 0) { spanId = nextSpanId_.fetch_add(1, std::memory_order_relaxed); }
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    const auto timestamp = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+    TraceRecord record{timestamp, spanId, arg, currentTraceThread(), event, phase};
+    if (!traceRing_.tryPush(std::move(record))) { traceDropped_.fetch_add(1, std::memory_order_relaxed); }
+    return spanId;
+}
+
+void Logger::drainTrace() {
+    // the ring has a single consumer, stopTrace may run on another thread than the flusher
+    std::lock_guard<std::mutex> lock(traceMtx_);
+    std::array<TraceRecord, 256> batch;
+    std::size_t count = 0;
+    while (traceRing_.tryPop(batch[count])) {
+        if (++count < batch.size()) { continue; }
+        if (traceFile_.is_open()) { traceFile_.write(reinterpret_cast<const char*>(batch.data()), count * sizeof(TraceRecord)); }
+        count = 0;
+    }
+    if (count > 0 && traceFile_.is_open()) { traceFile_.write(reinterpret_cast<const char*>(batch.data()), count * sizeof(TraceRecord)); }
+    const std::size_t dropped = traceDropped_.load(std::memory_order_relaxed);
+    if (dropped != reportedTraceDropped_) {
+        // the trace file has gaps now, spans may miss their end
+        pushLog(Log{LogLevel::WARN, std::format("WARNING: Trace buffer was full, dropped {} records.", dropped - reportedTraceDropped_)});
+        reportedTraceDropped_ = dropped;
+    }
+}
@@ -17,7 +17,7 @@ int main() {
     AutoGenInfo::setConfig(config);
     AutoGenInfo::setLogger(logger);
 
-    ThreadPool pool{10, logger};
+    ThreadPool pool{6, 4, logger};
 
     DbInterface dbInterface{logger};
     DbService dbService{dbInterface, pool, config, logger};
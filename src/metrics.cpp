@@ -0,0 +1,148 @@
+#include "metrics.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+
+namespace {
+// written only by the owning thread (plain load + store, no locked instructions), read by snapshot()
+struct Cell {
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> min{std::numeric_limits<uint64_t>::max()};
+    std::atomic<uint64_t> max{0};
+    std::array<std::atomic<uint64_t>, METRIC_BUCKET_COUNT> buckets{};
+};
+
+struct Shard {
+    std::array<Cell, MAX_METRICS> cells;
+};
+
+struct Definition {
+    std::string name;
+    MetricKind kind;
+};
+
+std::mutex registryMtx;
+std::vector<Definition> definitions;
+std::vector<std::unique_ptr<Shard>> shards; // outlive their threads, so nothing recorded gets lost
+
+thread_local Shard* localShard = nullptr;
+
+Shard& getLocalShard() {
+    if (!localShard) {
+        std::lock_guard<std::mutex> lock(registryMtx);
+        shards.push_back(std::make_unique<Shard>());
+        localShard = shards.back().get();
+    }
+    return *localShard;
+}
+
+void add(std::atomic<uint64_t>& target, uint64_t value) {
+    target.store(target.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+const char* kindName(MetricKind kind) {
+    switch (kind) {
+    case MetricKind::TIMER:
+        return "timer";
+    case MetricKind::COUNTER:
+        return "counter";
+    case MetricKind::HISTOGRAM:
+        return "histogram";
+    default:
+        return "unknown";
+    }
+}
+} // namespace
+
+std::size_t Metrics::registerMetric(const char* name, MetricKind kind) {
+    std::lock_guard<std::mutex> lock(registryMtx);
+    auto it = std::find_if(definitions.begin(), definitions.end(), [&](const Definition& d) { return d.name == name; });
+    if (it != definitions.end()) { return static_cast<std::size_t>(it - definitions.begin()); } // same metric from several sites
+    if (definitions.size() >= MAX_METRICS) { return INVALID_METRIC; }
+    definitions.push_back(Definition{name, kind});
+    return definitions.size() - 1;
+}
+
+void Metrics::record(std::size_t id, uint64_t value) {
+    if (id >= MAX_METRICS) { return; }
+    Cell& cell = getLocalShard().cells[id];
+    add(cell.count, 1);
+    add(cell.sum, value);
+    if (value < cell.min.load(std::memory_order_relaxed)) { cell.min.store(value, std::memory_order_relaxed); }
+    if (value > cell.max.load(std::memory_order_relaxed)) { cell.max.store(value, std::memory_order_relaxed); }
+    add(cell.buckets[std::min<std::size_t>(std::bit_width(value), METRIC_BUCKET_COUNT - 1)], 1);
+}
+
+std::vector<MetricSnapshot> Metrics::snapshot() {
+    std::lock_guard<std::mutex> lock(registryMtx);
+    std::vector<MetricSnapshot> result;
+    result.reserve(definitions.size());
+    for (std::size_t id = 0; id < definitions.size(); ++id) {
+        MetricSnapshot metric{definitions[id].name, definitions[id].kind};
+        uint64_t min = std::numeric_limits<uint64_t>::max();
+        for (const auto& shard : shards) {
+            const Cell& cell = shard->cells[id];
+            metric.count += cell.count.load(std::memory_order_relaxed);
+            metric.sum += cell.sum.load(std::memory_order_relaxed);
+            min = std::min(min, cell.min.load(std::memory_order_relaxed));
+            metric.max = std::max(metric.max, cell.max.load(std::memory_order_relaxed));
+            for (std::size_t b = 0; b < METRIC_BUCKET_COUNT; ++b) {
+                metric.buckets[b] += cell.buckets[b].load(std::memory_order_relaxed);
+            }
+        }
+        metric.min = metric.count > 0 ? min : 0;
+        result.push_back(std::move(metric));
+    }
+    return result;
+}
+
+void Metrics::reset() {
+    // racing recorders may put back a stale value, fine for a diagnostics reset
+    std::lock_guard<std::mutex> lock(registryMtx);
+    for (const auto& shard : shards) {
+        for (Cell& cell : shard->cells) {
+            cell.count.store(0, std::memory_order_relaxed);
+            cell.sum.store(0, std::memory_order_relaxed);
+            cell.min.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+            cell.max.store(0, std::memory_order_relaxed);
+            for (auto& bucket : cell.buckets) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+std::string Metrics::toJson() {
+    nlohmann::ordered_json j = nlohmann::ordered_json::array();
+    for (const MetricSnapshot& metric : snapshot()) {
+        nlohmann::ordered_json entry{{"name", metric.name},
+                                     {"kind", kindName(metric.kind)},
+                                     {"count", metric.count},
+                                     {"sum", metric.sum},
+                                     {"min", metric.min},
+                                     {"max", metric.max}};
+        // drop the empty tail of the histogram
+        std::size_t used = METRIC_BUCKET_COUNT;
+        while (used > 0 && metric.buckets[used - 1] == 0) {
+            --used;
+        }
+        entry["buckets"] = std::vector<uint64_t>(metric.buckets.begin(), metric.buckets.begin() + used);
+        j.push_back(std::move(entry));
+    }
+    return j.dump(2);
+}
+
+bool Metrics::exportJson(const std::filesystem::path& path) {
+    std::ofstream out(path);
+    if (!out) { return false; }
+    out << toJson();
+    return static_cast<bool>(out);
+}
@@ -1,4 +1,5 @@
 #include "partApi.hpp"
+#include "metrics.hpp"
 
 #undef DUMMY_API
 
@@ -39,7 +40,7 @@ CURLcode PartApi::triggerRequest(CURL* curl) {
 
 nlohmann::json PartApi::parseData(const std::string& response) {
     try {
-        logger_.pushLog(Log{std::format("RESPONSE:\n{}", response)});
+        logger_.log<LogLevel::DEBUG>("RESPONSE:\n{}", response);
         return nlohmann::json::parse(response);
     } catch (const nlohmann::json::type_error& e) {
         logger_.pushLog(Log{std::format("ERROR: Could not parse api respone: {}", e.what())});
@@ -85,10 +86,15 @@ PartApi::~PartApi() {
 }
 
 nlohmann::json PartApi::fetchDataPoint(std::string dataPoint, bool forceRefetch) {
+    METRIC_TIMER("api.fetchDataPoint");
     if (!forceRefetch) {
         std::lock_guard<std::mutex> lg{responses_.mtx};
-        if (responses_.data.contains(dataPoint)) { return responses_.data.at(dataPoint); }
+        if (responses_.data.contains(dataPoint)) {
+            METRIC_COUNT("api.archiveHits", 1);
+            return responses_.data.at(dataPoint);
+        }
     }
+    METRIC_COUNT("api.requests", 1);
     if (!init()) { return nlohmann::json{}; }
     std::unique_ptr<CURL, CurlDeleter> curl = std::unique_ptr<CURL, CurlDeleter>(curl_easy_init());
     if (!curl) {
@@ -126,6 +132,7 @@ nlohmann::json PartApi::fetchDataPoint(std::string dataPoint, bool forceRefetch)
     curl_easy_setopt(curl.get(), CURLOPT_HTTPHEADER, headers.get());
 
     if (triggerRequest(curl.get()) != CURLE_OK) { return nlohmann::json{}; }
+    METRIC_OBSERVE("api.responseBytes", responseString.size());
     nlohmann::json parsed = parseData(responseString);
     {
         std::lock_guard<std::mutex> lg{responses_.mtx};
@@ -134,11 +141,14 @@ nlohmann::json PartApi::fetchDataPoint(std::string dataPoint, bool forceRefetch)
     return parsed;
 }
 
-void PartApi::fetchExample(std::string dataPoint, UI::ApiPreviewState& state) {
-    pool_.submit([this, dataPoint = std::move(dataPoint), &state]() {
-        state.loading = true;
-        state.fields = fetchDataPoint(dataPoint);
-        state.loading = false;
-        state.ready = true;
-    });
+Task<nlohmann::json> PartApi::fetchDataPointAsync(std::string dataPoint, TaskPriority priority, bool forceRefetch) {
+    co_await pool_.schedule(TaskLane::IO, priority);
+    co_return fetchDataPoint(std::move(dataPoint), forceRefetch);
+}
+
+Task<void> PartApi::fetchExample(std::string dataPoint, UI::ApiPreviewState& state) {
+    state.loading = true;
+    state.fields = co_await fetchDataPointAsync(std::move(dataPoint), TaskPriority::HIGH);
+    state.loading = false;
+    state.ready = true;
 }
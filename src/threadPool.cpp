@@ -1,42 +1,115 @@
 #include "threadPool.hpp"
 #include "logger.hpp"
 
+#include <algorithm>
+#include <bit>
 #include <iostream>
 
-ThreadPool::ThreadPool(std::size_t cThreadCount, Logger& cLogger) : logger_(cLogger) {
-    workers_.reserve(cThreadCount);
-    for (std::size_t i = 0; i < cThreadCount; ++i) {
-        workers_.emplace_back(&ThreadPool::workerLoop, this);
+ThreadPool::ThreadPool(std::size_t cCpuThreadCount, std::size_t cIoThreadCount, Logger& cLogger) : logger_(cLogger) {
+    const std::array<std::size_t, LANE_COUNT> counts{std::max(std::size_t(1), cCpuThreadCount), std::max(std::size_t(1), cIoThreadCount)};
+    for (std::size_t l = 0; l < LANE_COUNT; ++l) {
+        Lane& lane = lanes_[l];
+        lane.workers.reserve(counts[l]);
+        for (std::size_t i = 0; i < counts[l]; ++i) {
+            // keep one cpu worker free for high priority (ui facing) work, as long as there is more than one
+            const bool highOnly = l == static_cast<std::size_t>(TaskLane::CPU) && i == 0 && counts[l] > 1;
+            lane.workers.emplace_back(&ThreadPool::workerLoop, this, std::ref(lane), highOnly);
+        }
     }
-    logger_.pushLog(Log(std::format("created {} threads", cThreadCount)));
+    logger_.pushLog(Log(std::format("created {} cpu and {} io threads", counts[0], counts[1])));
 }
 
 ThreadPool::~ThreadPool() {
     stopping_ = true;
-    cv_.notify_all();
+    for (Lane& lane : lanes_) {
+        // taking the lock guarantees no worker sits between its predicate check and the wait
+        std::lock_guard<std::mutex> lock(lane.mtx);
+        lane.cv.notify_all();
+        lane.cvHigh.notify_all();
+    }
 
-    for (auto& t : workers_) {
-        if (t.joinable()) { t.join(); }
+    for (Lane& lane : lanes_) {
+        for (auto& t : lane.workers) {
+            if (t.joinable()) { t.join(); }
+        }
     }
     logger_.pushLog(Log(std::format("deleted threads")));
 }
 
-void ThreadPool::workerLoop() {
+void ThreadPool::enqueue(TaskLane laneType, TaskPriority priority, std::function<void()> task) {
+    Lane& lane = lanes_[static_cast<std::size_t>(laneType)];
+    const std::size_t p = static_cast<std::size_t>(priority);
+    {
+        std::lock_guard<std::mutex> lock(lane.mtx);
+        lane.queues[p].push(QueuedTask{std::move(task), std::chrono::steady_clock::now()});
+        lane.depth[p].fetch_add(1, std::memory_order_relaxed);
+    }
+    lane.cv.notify_one();
+    if (priority == TaskPriority::HIGH) { lane.cvHigh.notify_one(); }
+}
+
+bool ThreadPool::popTask(Lane& lane, bool highOnly, QueuedTask& out) {
+    const std::size_t considered = highOnly ? 1 : PRIORITY_COUNT;
+    for (std::size_t p = 0; p < considered; ++p) {
+        if (lane.queues[p].empty()) { continue; }
+        out = std::move(lane.queues[p].front());
+        lane.queues[p].pop();
+        lane.depth[p].fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(Lane& lane, bool highOnly) {
+    auto hasWork = [&lane, highOnly] {
+        if (highOnly) { return !lane.queues[static_cast<std::size_t>(TaskPriority::HIGH)].empty(); }
+        return std::any_of(lane.queues.begin(), lane.queues.end(), [](const auto& q) { return !q.empty(); });
+    };
+
     while (true) {
-        std::function<void()> task;
+        QueuedTask queued;
         {
-            std::unique_lock<std::mutex> lock(mtx_);
-            cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            std::unique_lock<std::mutex> lock(lane.mtx);
+            std::condition_variable& cv = highOnly ? lane.cvHigh : lane.cv;
+            cv.wait(lock, [&] { return stopping_ || hasWork(); });
 
-            if (stopping_ && tasks_.empty()) { return; }
-
-            task = std::move(tasks_.front());
-            tasks_.pop();
+            if (stopping_ && !hasWork()) { return; }
+            if (!popTask(lane, highOnly, queued)) { continue; }
         }
-        task(); // execute outside the lock
+        recordWait(lane, std::chrono::steady_clock::now() - queued.enqueued);
+        lane.busy.fetch_add(1, std::memory_order_relaxed);
+        queued.task(); // execute outside the lock
+        lane.busy.fetch_sub(1, std::memory_order_relaxed);
+        lane.executed.fetch_add(1, std::memory_order_relaxed);
     }
 }
 
-std::size_t ThreadPool::getAvailableThreadCount() const {
-    return workers_.size() - tasks_.size();
-}
\ No newline at end of file
+void ThreadPool::recordWait(Lane& lane, std::chrono::steady_clock::duration wait) {
+    const auto us = static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(wait).count()));
+    const std::size_t bucket = std::min<std::size_t>(std::bit_width(us), WAIT_BUCKET_COUNT - 1);
+    lane.waitHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+std::size_t ThreadPool::getAvailableThreadCount(TaskLane laneType) const {
+    const Lane& lane = lanes_[static_cast<std::size_t>(laneType)];
+    std::size_t occupied = lane.busy.load(std::memory_order_relaxed);
+    for (const auto& d : lane.depth) {
+        occupied += d.load(std::memory_order_relaxed);
+    }
+    return occupied >= lane.workers.size() ? 0 : lane.workers.size() - occupied;
+}
+
+LaneStats ThreadPool::getLaneStats(TaskLane laneType) const {
+    const Lane& lane = lanes_[static_cast<std::size_t>(laneType)];
+    LaneStats stats;
+    stats.workers = lane.workers.size();
+    stats.busy = lane.busy.load(std::memory_order_relaxed);
+    stats.executed = lane.executed.load(std::memory_order_relaxed);
+    for (std::size_t p = 0; p < PRIORITY_COUNT; ++p) {
+        stats.queueDepth[p] = lane.depth[p].load(std::memory_order_relaxed);
+    }
+    for (std::size_t b = 0; b < WAIT_BUCKET_COUNT; ++b) {
+        stats.waitHistogram[b] = lane.waitHistogram[b].load(std::memory_order_relaxed);
+    }
+    return stats;
+}
@@ -268,10 +268,11 @@ void DbTable::drawInsertionCellsOfColumn(const std::string& tableName,
                                          ImVec2& cursor,
                                          std::size_t& cellIndex) {
     if (!uiChanges_) { return; }
-    if (!uiChanges_->idMappedChanges.contains(tableName)) { return; }
+    const uiTableChanges* tableChanges = uiChanges_->getTable(tableName);
+    if (!tableChanges) { return; }
 
-    for (const auto& [pKeyNum, changeKey] : uiChanges_->idMappedChanges.at(tableName)) {
-        Change& change = uiChanges_->changes.at(changeKey);
+    for (const auto& [pKeyNum, changeKey] : tableChanges->idMappedChanges) {
+        const Change& change = tableChanges->changes.at(changeKey);
         if (change.getType() != ChangeType::INSERT_ROW) { continue; }
         const std::string pKey = std::to_string(pKeyNum);
 
@@ -321,7 +322,7 @@ void DbTable::drawInsertionCellsOfColumn(const std::string& tableName,
 
 // Draw overlay for inserted/updated cell values for given Change
 void DbTable::drawChangeOverlayIfNeeded(
-    Change* ch, const std::string& originalValue, const std::string& headerName, const Rect& r, const EventTypes& event) {
+    const Change* ch, const std::string& originalValue, const std::string& headerName, const Rect& r, const EventTypes& event) {
     if (!ch) { return; }
     const std::string val = ch->getCell(headerName);
     if (val.empty()) { return; }
@@ -442,7 +443,7 @@ void DbTable::drawChangeInCell(const CellInfo& cell, const Rect& r, ImVec2 textP
             isValid = cell.header.nullable || !value.empty();
         } else {
             for (const std::size_t key : cell.change->getChildren()) {
-                const Change& child = uiChanges_.get()->changes.at(key);
+                const Change& child = uiChanges_->getChange(key);
                 if (child.getTable() == cell.header.name) {
                     isValid = child.isLocallyValid();
                     break;
@@ -522,7 +523,7 @@ void DbTable::setData(std::shared_ptr<const CompleteDbData> newData) {
     }
 }
 
-void DbTable::setChangeData(std::shared_ptr<uiChangeInfo> changeData) {
+void DbTable::setChangeData(std::shared_ptr<const uiChangeInfo> changeData) {
     uiChanges_ = changeData;
 }
 
@@ -534,7 +535,7 @@ void DbTable::popEvent() {
     lastEvent_ = Event();
 }
 
-void ChangeOverviewer::setChangeData(std::shared_ptr<uiChangeInfo> changeData) {
+void ChangeOverviewer::setChangeData(std::shared_ptr<const uiChangeInfo> changeData) {
     uiChanges = changeData;
 }
 
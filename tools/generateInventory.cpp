@@ -0,0 +1,58 @@
+// Writes a synthetic inventory (see InventoryGenerator) for load and soak tests.
+// Usage: GenerateInventory <outDir> [--seed N] [--parts N] [--depth N] [--fanout N] [--rows N] [--bom N] [--order N] [--new-share X]
+// Load it with: psql -d <db> -f schema.sql -f data.sql
+
+#include "inventoryGenerator.hpp"
+
+#include <charconv>
+#include <iostream>
+#include <string_view>
+
+namespace {
+template <typename T> bool parseValue(std::string_view text, T& value) {
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc{} && ptr == text.data() + text.size();
+}
+
+bool parseOption(std::string_view name, std::string_view value, GeneratorOptions& options) {
+    if (name == "--seed") { return parseValue(value, options.seed); }
+    if (name == "--parts") { return parseValue(value, options.parts); }
+    if (name == "--depth") { return parseValue(value, options.depth); }
+    if (name == "--fanout") { return parseValue(value, options.fanout); }
+    if (name == "--rows") { return parseValue(value, options.rowsPerTable); }
+    if (name == "--bom") { return parseValue(value, options.bomRows); }
+    if (name == "--order") { return parseValue(value, options.orderRows); }
+    if (name == "--new-share") {
+        return parseValue(value, options.newPartShare) && options.newPartShare >= 0.0 && options.newPartShare <= 1.0;
+    }
+    return false;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2 || argc % 2 != 0) {
+        std::cerr << "Usage: GenerateInventory <outDir> [--seed N] [--parts N] [--depth N] [--fanout N] [--rows N] [--bom N] [--order N]"
+                     " [--new-share X]\n";
+        return 1;
+    }
+    GeneratorOptions options;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (!parseOption(argv[i], argv[i + 1], options)) {
+            std::cerr << "ERROR: Invalid option " << argv[i] << ' ' << argv[i + 1] << '\n';
+            return 1;
+        }
+    }
+
+    Logger logger;
+    const InventoryGenerator generator{options};
+    if (!generator.writeFiles(argv[1], logger)) { return 1; }
+
+    std::size_t rows = 0;
+    for (const auto& [table, count] : generator.getData().maxPKeys) {
+        rows += count;
+    }
+    std::cout << "Generated " << generator.getData().tables.size() << " tables with " << rows << " rows, "
+              << generator.getBom().rows.size() - 1 << " bom and " << generator.getOrder().rows.size() - 1 << " order lines in "
+              << argv[1] << '\n';
+    return 0;
+}
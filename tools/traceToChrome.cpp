@@ -0,0 +1,98 @@
+// Converts a binary trace written by Logger::startTrace into Chrome trace-event JSON (chrome://tracing, Perfetto).
+// Usage: TraceToChrome <trace.bin> [trace.json]
+
+#include "trace.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+std::vector<TraceRecord> readRecords(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "ERROR: Could not open " << path.string() << '\n';
+        return {};
+    }
+    std::array<char, TRACE_MAGIC.size()> magic{};
+    in.read(magic.data(), magic.size());
+    if (!in || magic != TRACE_MAGIC) {
+        std::cerr << "ERROR: " << path.string() << " is not a trace file.\n";
+        return {};
+    }
+
+    std::vector<TraceRecord> records;
+    TraceRecord record;
+    while (in.read(reinterpret_cast<char*>(&record), sizeof(TraceRecord))) {
+        records.push_back(record);
+    }
+    return records;
+}
+
+void writeEvent(std::ostream& out, bool& first, const TraceRecord& record, char phase, uint64_t start, uint64_t durationNs) {
+    out << (first ? "\n" : ",\n");
+    first = false;
+    out << R"(  {"name":")" << traceEventName(record.event) << R"(","cat":"inventory","ph":")" << phase << R"(","pid":1,"tid":)"
+        << record.threadId << R"(,"ts":)" << (record.timestampNs - start) / 1000.0;
+    if (phase == 'X') { out << R"(,"dur":)" << durationNs / 1000.0; }
+    if (phase == 'i') { out << R"(,"s":"t")"; }
+    out << R"(,"args":{"span":)" << record.spanId << R"(,"arg":)" << record.arg << "}}";
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: TraceToChrome <trace.bin> [trace.json]\n";
+        return 1;
+    }
+    const std::filesystem::path input = argv[1];
+    const std::filesystem::path output =
+        argc > 2 ? std::filesystem::path(argv[2]) : std::filesystem::path(input).replace_extension(".json");
+
+    std::vector<TraceRecord> records = readRecords(input);
+    if (records.empty()) { return 1; }
+    // the flusher writes in ring order, which is only roughly chronological across threads
+    std::stable_sort(
+        records.begin(), records.end(), [](const TraceRecord& a, const TraceRecord& b) { return a.timestampNs < b.timestampNs; });
+    const uint64_t start = records.front().timestampNs;
+
+    std::ofstream out(output);
+    if (!out) {
+        std::cerr << "ERROR: Could not write " << output.string() << '\n';
+        return 1;
+    }
+
+    // spans become complete events on the thread they began on, END records carry the result argument
+    std::unordered_map<uint64_t, TraceRecord> open;
+    bool first = true;
+    out << R"({"displayTimeUnit":"ms","traceEvents":[)";
+    for (const TraceRecord& record : records) {
+        switch (record.phase) {
+        case TracePhase::BEGIN:
+            open.insert_or_assign(record.spanId, record);
+            break;
+        case TracePhase::END: {
+            auto it = open.find(record.spanId);
+            if (it == open.end()) { break; } // began before the trace started
+            TraceRecord span = it->second;
+            if (record.arg != 0) { span.arg = record.arg; }
+            writeEvent(out, first, span, 'X', start, record.timestampNs - span.timestampNs);
+            open.erase(it);
+        } break;
+        case TracePhase::INSTANT:
+            writeEvent(out, first, record, 'i', start, 0);
+            break;
+        }
+    }
+    // spans still running when the trace stopped
+    for (const auto& [spanId, span] : open) {
+        writeEvent(out, first, span, 'B', start, 0);
+    }
+    out << "\n]}\n";
+
+    std::cout << "Converted " << records.size() << " records to " << output.string() << '\n';
+    return 0;
+}